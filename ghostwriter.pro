@@ -101,15 +101,21 @@ HEADERS += \
     src/colorscheme.h \
     src/colorschemepreviewer.h \
     src/commandlineexporter.h \
+    src/contenthash.h \
+    src/documentcache.h \
     src/documenthistory.h \
     src/documentmanager.h \
     src/documentstatistics.h \
     src/documentstatisticswidget.h \
+    src/editjournal.h \
     src/exportdialog.h \
     src/exporter.h \
     src/exporterfactory.h \
     src/exportformat.h \
     src/htmlpreview.h \
+    src/largefilepager.h \
+    src/linediff.h \
+    src/lineindex.h \
     src/localedialog.h \
     src/mainwindow.h \
     src/markdowndocument.h \
@@ -138,13 +144,18 @@ HEADERS += \
     src/themerepository.h \
     src/themeselectiondialog.h \
     src/timelabel.h \
+    src/trigramindex.h \
     src/findreplace.h \
+    src/foldersearch.h \
+    src/foldersearchwidget.h \
     src/color_button.h \
     src/spelling/dictionary.h \
     src/spelling/dictionaryprovider.h \
     src/spelling/dictionarymanager.h \
     src/spelling/spellchecker.h \
-    src/spelling/spellcheckdecorator.h
+    src/spelling/spellcheckdecorator.h \
+    src/spelling/suggestioncache.h \
+    src/spelling/verdictcache.h
 
 SOURCES += \
     src/abstractstatisticswidget.cpp \
@@ -155,15 +166,21 @@ SOURCES += \
     src/cmarkgfmexporter.cpp \
     src/colorschemepreviewer.cpp \
     src/commandlineexporter.cpp \
+    src/contenthash.cpp \
+    src/documentcache.cpp \
     src/documenthistory.cpp \
     src/documentmanager.cpp \
     src/documentstatistics.cpp \
     src/documentstatisticswidget.cpp \
+    src/editjournal.cpp \
     src/exportdialog.cpp \
     src/exporter.cpp \
     src/exporterfactory.cpp \
     src/exportformat.cpp \
     src/htmlpreview.cpp \
+    src/largefilepager.cpp \
+    src/linediff.cpp \
+    src/lineindex.cpp \
     src/localedialog.cpp \
     src/mainwindow.cpp \
     src/markdowndocument.cpp \
@@ -189,11 +206,16 @@ SOURCES += \
     src/themerepository.cpp \
     src/themeselectiondialog.cpp \
     src/timelabel.cpp \
+    src/trigramindex.cpp \
     src/color_button.cpp \
     src/findreplace.cpp \
+    src/foldersearch.cpp \
+    src/foldersearchwidget.cpp \
     src/spelling/dictionarymanager.cpp \
     src/spelling/spellchecker.cpp \
-    src/spelling/spellcheckdecorator.cpp
+    src/spelling/spellcheckdecorator.cpp \
+    src/spelling/suggestioncache.cpp \
+    src/spelling/verdictcache.cpp
 
 # Generate translations
 TRANSLATIONS = $$files(translations/ghostwriter_*.ts)
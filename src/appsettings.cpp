@@ -38,6 +38,8 @@
 #define GW_REMEMBER_FILE_HISTORY_KEY "Session/rememberFileHistory"
 #define GW_AUTOSAVE_KEY "Save/autoSave"
 #define GW_BACKUP_FILE_KEY "Save/backupFile"
+#define GW_BACKUP_COUNT_KEY "Save/backupCount"
+#define GW_EDIT_JOURNAL_KEY "Save/editJournal"
 #define GW_EDITOR_FONT_KEY "Style/editorFont"
 #define GW_LARGE_HEADINGS_KEY "Style/largeHeadings"
 #define GW_AUTO_MATCH_KEY "Typing/autoMatchEnabled"
@@ -85,6 +87,8 @@ public:
     bool autoMatchEnabled;
     bool autoSaveEnabled;
     bool backupFileEnabled;
+    int backupCount;
+    bool editJournalEnabled;
     QString draftLocation;
     bool bulletPointCyclingEnabled;
     bool displayTimeInFullScreenEnabled;
@@ -143,6 +147,8 @@ void AppSettings::store()
     appSettings.setValue(GW_AUTO_MATCH_KEY, QVariant(d->autoMatchEnabled));
     appSettings.setValue(GW_AUTOSAVE_KEY, QVariant(d->autoSaveEnabled));
     appSettings.setValue(GW_BACKUP_FILE_KEY, QVariant(d->backupFileEnabled));
+    appSettings.setValue(GW_BACKUP_COUNT_KEY, QVariant(d->backupCount));
+    appSettings.setValue(GW_EDIT_JOURNAL_KEY, QVariant(d->editJournalEnabled));
     appSettings.setValue(GW_BULLET_CYCLING_KEY, QVariant(d->bulletPointCyclingEnabled));
     appSettings.setValue(GW_DICTIONARY_KEY, QVariant(d->dictionaryLanguage));
     appSettings.setValue(GW_DISPLAY_TIME_IN_FULL_SCREEN_KEY, QVariant(d->displayTimeInFullScreenEnabled));
@@ -223,6 +229,38 @@ void AppSettings::setBackupFileEnabled(bool enabled)
     emit backupFileChanged(enabled);
 }
 
+int AppSettings::backupCount() const
+{
+    Q_D(const AppSettings);
+    
+    return d->backupCount;
+}
+
+void AppSettings::setBackupCount(int count)
+{
+    Q_D(AppSettings);
+    
+    if ((count >= MIN_BACKUP_COUNT) && (count <= MAX_BACKUP_COUNT)) {
+        d->backupCount = count;
+        emit backupCountChanged(count);
+    }
+}
+
+bool AppSettings::editJournalEnabled() const
+{
+    Q_D(const AppSettings);
+    
+    return d->editJournalEnabled;
+}
+
+void AppSettings::setEditJournalEnabled(bool enabled)
+{
+    Q_D(AppSettings);
+    
+    d->editJournalEnabled = enabled;
+    emit editJournalChanged(enabled);
+}
+
 QString AppSettings::draftLocation() const
 {
     Q_D(const AppSettings);
@@ -802,6 +840,13 @@ AppSettings::AppSettings()
 
     d->autoSaveEnabled = appSettings.value(GW_AUTOSAVE_KEY, QVariant(true)).toBool();
     d->backupFileEnabled = appSettings.value(GW_BACKUP_FILE_KEY, QVariant(true)).toBool();
+    d->backupCount = appSettings.value(GW_BACKUP_COUNT_KEY, QVariant(DEFAULT_BACKUP_COUNT)).toInt();
+
+    if ((d->backupCount < MIN_BACKUP_COUNT) || (d->backupCount > MAX_BACKUP_COUNT)) {
+        d->backupCount = DEFAULT_BACKUP_COUNT;
+    }
+
+    d->editJournalEnabled = appSettings.value(GW_EDIT_JOURNAL_KEY, QVariant(false)).toBool();
     d->editorFont.fromString(appSettings.value(GW_EDITOR_FONT_KEY, QVariant(monospaceFont)).toString());
     d->previewTextFont.fromString(appSettings.value(GW_PREVIEW_TEXT_FONT_KEY, QVariant(variableFont)).toString());
     d->previewCodeFont.fromString(appSettings.value(GW_PREVIEW_CODE_FONT_KEY, QVariant(monospaceFont)).toString());
@@ -47,6 +47,9 @@ public:
     static const int MIN_TAB_WIDTH = 1;
     static const int MAX_TAB_WIDTH = 8;
     static const int DEFAULT_TAB_WIDTH = 4;
+    static const int MIN_BACKUP_COUNT = 1;
+    static const int MAX_BACKUP_COUNT = 99;
+    static const int DEFAULT_BACKUP_COUNT = 1;
 
     static AppSettings *instance();
     ~AppSettings();
@@ -66,6 +69,14 @@ public:
     Q_SLOT void setBackupFileEnabled(bool enabled);
     Q_SIGNAL void backupFileChanged(bool enabled);
 
+    int backupCount() const;
+    Q_SLOT void setBackupCount(int count);
+    Q_SIGNAL void backupCountChanged(int count);
+
+    bool editJournalEnabled() const;
+    Q_SLOT void setEditJournalEnabled(bool enabled);
+    Q_SIGNAL void editJournalChanged(bool enabled);
+
     QFont editorFont() const;
     void setEditorFont(const QFont &font);
 
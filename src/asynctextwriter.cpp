@@ -18,13 +18,38 @@
  ***********************************************************************/
 
 #include <QApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QPair>
 #include <QSaveFile>
+#include <QStringList>
+#include <QTemporaryFile>
 #include <QtConcurrentRun>
 #include <QTextStream>
 
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define ASYNC_TEXT_WRITER_SSE2
+#endif
+
 #include "asynctextwriter.h"
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
@@ -33,6 +58,15 @@
 #define DEFAULT_STREAM_CODEC QStringConverter::Utf8;
 #endif
 
+// Number of UTF-16 code units encoded at a time when writing UTF-8.  The
+// chunk buffer is three times as many bytes, which is enough for any text.
+#define UTF8_CHUNK_LENGTH (256 * 1024)
+
+// Backups are named after the file, followed by the time of the backup in
+// UTC, which sorts them from oldest to newest by name.
+#define BACKUP_TIMESTAMP_FORMAT "yyyyMMdd-HHmmss-zzz"
+#define BACKUP_SUFFIX ".backup"
+
 namespace ghostwriter
 {
 class AsyncTextWriterPrivate
@@ -47,11 +81,63 @@ public:
     AsyncTextWriter *q_ptr;
     QString fileName;
     AsyncTextWriter::Encoding encoding;
-    QFutureWatcher<QString> *writeFutureWatcher = nullptr;
+    AsyncTextWriter::Durability durability = AsyncTextWriter::SyncData;
+    int backupCount = 0;
+    QFutureWatcher<QPair<QString, QString>> *writeFutureWatcher = nullptr;
     bool writeInProgress = false;
 
+    // Text of the latest write requested while another was running.
+    // QString is implicitly shared, so holding on to it costs no copy.
+    bool writePending = false;
+    QString pendingText;
+    AsyncTextWriter::Durability pendingDurability = AsyncTextWriter::NoSync;
+    QElapsedTimer runningTimer;
+    QElapsedTimer pendingTimer;
+    qint64 lastLatency = -1;
+
     void initialize(const QString &fileName);
 
+    /*
+    * Starts writing the given text on a worker thread.  The timer holds
+    * the time at which the write was requested.
+    */
+    void startWrite
+    (
+        const QString &text,
+        AsyncTextWriter::Durability durability,
+        const QElapsedTimer &requested
+    );
+
+    int queueDepth() const;
+
+    /*
+    * Backs up the file, if requested, then writes the given text to it.
+    * Returns the write error and the backup error, each of which is a
+    * null string on success.  Runs on a worker thread.
+    */
+    static QPair<QString, QString> backupAndWrite(const QString &text,
+        const QString &fileName,
+        AsyncTextWriter::Encoding encoding,
+        AsyncTextWriter::Durability durability,
+        int backupCount);
+
+    /*
+    * Copies the given file to a new timestamped backup next to it, then
+    * removes the oldest of its backups beyond the given count.  Returns
+    * a null string if successful, otherwise an error message.  Note that
+    * this method is intended to be run in a separate thread from the main
+    * Qt event loop, and should thus never interact with any widgets.
+    */
+    static QString backupFile(const QString &fileName, int backupCount);
+
+    /*
+    * Creates the destination file as a copy-on-write clone of the source
+    * file, sharing its data on disk.  Returns false if the file system
+    * (or platform) does not support cloning, in which case the file must
+    * be copied instead.
+    */
+    static bool cloneFile(const QString &source, const QString &destination);
+
     /*
     * Writes the given text to the given file path, returning a null
     * string if successful, otherwise an error message.  Note that this
@@ -60,8 +146,50 @@ public:
     */
     static QString writeToDisk(const QString &text,
         const QString &fileName,
+        AsyncTextWriter::Encoding encoding,
+        AsyncTextWriter::Durability durability);
+
+    /*
+    * Writes the given text to the given open file, returning false if
+    * an error occurs.  UTF-8 text is encoded in large chunks straight to
+    * the file, in which case the file must be opened without the Text
+    * flag, since line endings are translated here instead.
+    */
+    static bool writeText(QFileDevice &file,
+        const QString &text,
         AsyncTextWriter::Encoding encoding);
 
+    /*
+    * Encodes the given UTF-16 text as UTF-8 into the given buffer, which
+    * must hold at least three bytes per code unit, and returns the number
+    * of bytes written.  Line feeds are written as CR LF if crlf is true.
+    * Unpaired surrogates are replaced with U+FFFD.
+    */
+    static int encodeUtf8(const QChar *text, int length, char *buffer, bool crlf);
+
+    static bool isUtf8(AsyncTextWriter::Encoding encoding);
+
+#ifdef Q_OS_UNIX
+    /*
+    * Replaces the file with the given text by writing it to a temporary
+    * file next to it and renaming that over the original, without
+    * flushing anything to disk.  Returns false if the file does not
+    * exist yet or the temporary file could not be created, in which case
+    * the caller should fall back to QSaveFile.  Otherwise, the error
+    * message is returned in error.
+    */
+    static bool replaceWithoutSync(const QString &text,
+        const QString &fileName,
+        AsyncTextWriter::Encoding encoding,
+        QString &error);
+
+    /*
+    * Flushes the folder holding the given file, so that a file that was
+    * just renamed into it survives a crash.
+    */
+    static void syncDirectory(const QString &fileName);
+#endif
+
     /*
     * Handles any errors or tidying up after an asynchronous save operation.
     */
@@ -118,6 +246,34 @@ AsyncTextWriter::Encoding AsyncTextWriter::encoding() const
     return d->encoding;
 }
 
+AsyncTextWriter::Durability AsyncTextWriter::durability() const
+{
+    Q_D(const AsyncTextWriter);
+
+    return d->durability;
+}
+
+void AsyncTextWriter::setDurability(AsyncTextWriter::Durability durability)
+{
+    Q_D(AsyncTextWriter);
+
+    d->durability = durability;
+}
+
+int AsyncTextWriter::backupCount() const
+{
+    Q_D(const AsyncTextWriter);
+
+    return d->backupCount;
+}
+
+void AsyncTextWriter::setBackupCount(int count)
+{
+    Q_D(AsyncTextWriter);
+
+    d->backupCount = qMax(0, count);
+}
+
 bool AsyncTextWriter::writeInProgress() const
 {
     Q_D(const AsyncTextWriter);
@@ -125,15 +281,32 @@ bool AsyncTextWriter::writeInProgress() const
     return d->writeInProgress;
 }
 
-void AsyncTextWriter::waitForFinished()
+int AsyncTextWriter::queueDepth() const
+{
+    Q_D(const AsyncTextWriter);
+
+    return d->queueDepth();
+}
+
+qint64 AsyncTextWriter::lastLatency() const
 {
     Q_D(const AsyncTextWriter);
 
-    if (d->writeFutureWatcher->isRunning() || d->writeFutureWatcher->isStarted()) {
+    return d->lastLatency;
+}
+
+void AsyncTextWriter::waitForFinished()
+{
+    Q_D(AsyncTextWriter);
+
+    // Block on the worker instead of spinning the event loop, which would
+    // let user input and timers in while the caller is in the middle of
+    // closing or switching documents.  Completing the running write
+    // starts the pending one, if any, so keep going until both are done.
+    while (d->writeInProgress) {
         d->writeFutureWatcher->waitForFinished();
+        d->onWriteCompleted();
     }
-
-    qApp->processEvents();
 }
 
 bool AsyncTextWriter::write(const QString &text)
@@ -144,28 +317,28 @@ bool AsyncTextWriter::write(const QString &text)
         return false;
     }
 
-    if (d->writeFutureWatcher->isRunning()
-            || d->writeFutureWatcher->isStarted()) {
-        d->writeFutureWatcher->waitForFinished();
-    }
-
-    d->writeInProgress = true;
-
-    QFuture<QString> future =
-        QtConcurrent::run
-        (
-            &AsyncTextWriterPrivate::writeToDisk,
-            text,
-            d->fileName,
-            d->encoding
-        );
-
-    d->writeFutureWatcher->setFuture(future);
+    QElapsedTimer requested;
+    requested.start();
+
+    if (d->writeInProgress) {
+        // Latest wins.  Keep the time of the oldest request being
+        // coalesced, so that the latency covers the whole wait.
+        // The strongest durability requested wins, so that coalescing an
+        // explicit save with a later autosave still syncs it to disk.
+        if (!d->writePending) {
+            d->pendingTimer = requested;
+            d->pendingDurability = d->durability;
+        } else {
+            d->pendingDurability = qMax(d->pendingDurability, d->durability);
+        }
 
-    if (d->fileName.isNull() || d->fileName.isEmpty()) {
-        return false;
+        d->writePending = true;
+        d->pendingText = text;
+        emit queueChanged(d->queueDepth(), d->lastLatency);
+        return true;
     }
 
+    d->startWrite(text, d->durability, requested);
     return true;
 }
 
@@ -175,55 +348,428 @@ void AsyncTextWriterPrivate::initialize(const QString &fileName)
 
     this->fileName = QFileInfo(fileName).absoluteFilePath();
     this->encoding = DEFAULT_STREAM_CODEC;
-    this->writeFutureWatcher = new QFutureWatcher<QString>(q);
+    this->writeFutureWatcher = new QFutureWatcher<QPair<QString, QString>>(q);
 
     q->connect(this->writeFutureWatcher,
-        &QFutureWatcher<QString>::finished,
+        &QFutureWatcherBase::finished,
         [this]() {
-            this->onWriteCompleted();
+            // The write may already have been completed by
+            // waitForFinished(), in which case there is nothing left to do
+            // until the write now running, if any, finishes.
+            if (this->writeInProgress
+                    && this->writeFutureWatcher->future().isFinished()) {
+                this->onWriteCompleted();
+            }
         }
     );
 }
 
+void AsyncTextWriterPrivate::startWrite
+(
+    const QString &text,
+    AsyncTextWriter::Durability durability,
+    const QElapsedTimer &requested
+)
+{
+    Q_Q(AsyncTextWriter);
+
+    this->writeInProgress = true;
+    this->runningTimer = requested;
+
+    QFuture<QPair<QString, QString>> future =
+        QtConcurrent::run
+        (
+            &AsyncTextWriterPrivate::backupAndWrite,
+            text,
+            this->fileName,
+            this->encoding,
+            durability,
+            this->backupCount
+        );
+
+    this->writeFutureWatcher->setFuture(future);
+    emit q->queueChanged(queueDepth(), this->lastLatency);
+}
+
+int AsyncTextWriterPrivate::queueDepth() const
+{
+    return (this->writeInProgress ? 1 : 0) + (this->writePending ? 1 : 0);
+}
+
+QPair<QString, QString> AsyncTextWriterPrivate::backupAndWrite(const QString &text,
+    const QString &fileName,
+    AsyncTextWriter::Encoding encoding,
+    AsyncTextWriter::Durability durability,
+    int backupCount)
+{
+    QString backupError;
+
+    if (backupCount > 0) {
+        backupError = backupFile(fileName, backupCount);
+    }
+
+    return qMakePair(writeToDisk(text, fileName, encoding, durability),
+        backupError);
+}
+
+QString AsyncTextWriterPrivate::backupFile(const QString &fileName, int backupCount)
+{
+    QFileInfo info(fileName);
+
+    if (!info.exists()) {
+        return QString();
+    }
+
+    QString prefix = info.fileName() + ".";
+    QString backupName = info.absolutePath() + "/" + prefix
+        + QDateTime::currentDateTimeUtc().toString(BACKUP_TIMESTAMP_FORMAT)
+        + BACKUP_SUFFIX;
+
+    if (QFile::exists(backupName) && !QFile::remove(backupName)) {
+        return QObject::tr("Could not replace %1").arg(backupName);
+    }
+
+    if (!cloneFile(fileName, backupName)) {
+        QFile file(fileName);
+
+        // Leave the existing backups alone if this one failed.
+        if (!file.copy(backupName)) {
+            return file.errorString();
+        }
+    }
+
+    QDir dir = info.absoluteDir();
+    QStringList backups;
+
+    for (const QString &name : dir.entryList(QDir::Files | QDir::Hidden)) {
+        if (name.startsWith(prefix) && name.endsWith(BACKUP_SUFFIX)) {
+            QString timestamp = name.mid(prefix.length(),
+                name.length() - prefix.length() - QString(BACKUP_SUFFIX).length());
+
+            if (QDateTime::fromString(timestamp, BACKUP_TIMESTAMP_FORMAT).isValid()) {
+                backups.append(name);
+            }
+        }
+    }
+
+    backups.sort();
+
+    for (int i = 0; i < (backups.size() - backupCount); i++) {
+        dir.remove(backups[i]);
+    }
+
+    return QString();
+}
+
+bool AsyncTextWriterPrivate::cloneFile(const QString &source,
+    const QString &destination)
+{
+#ifdef FICLONE
+    int sourceFd = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+
+    if (sourceFd < 0) {
+        return false;
+    }
+
+    struct stat status;
+
+    if (0 != ::fstat(sourceFd, &status)) {
+        ::close(sourceFd);
+        return false;
+    }
+
+    QByteArray destinationPath = QFile::encodeName(destination);
+    int destinationFd = ::open(destinationPath.constData(),
+        O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, status.st_mode & 07777);
+
+    if (destinationFd < 0) {
+        ::close(sourceFd);
+        return false;
+    }
+
+    bool cloned = (0 == ::ioctl(destinationFd, FICLONE, sourceFd));
+
+    ::close(destinationFd);
+    ::close(sourceFd);
+
+    if (!cloned) {
+        ::unlink(destinationPath.constData());
+    }
+
+    return cloned;
+#else
+    Q_UNUSED(source)
+    Q_UNUSED(destination)
+    return false;
+#endif
+}
+
 QString AsyncTextWriterPrivate::writeToDisk(const QString &text,
     const QString &fileName,
-    AsyncTextWriter::Encoding encoding)
+    AsyncTextWriter::Encoding encoding,
+    AsyncTextWriter::Durability durability)
 {
+#ifdef Q_OS_UNIX
+    if (AsyncTextWriter::NoSync == durability) {
+        QString error;
+
+        if (replaceWithoutSync(text, fileName, encoding, error)) {
+            return error;
+        }
+    }
+#endif
+
     QSaveFile file(fileName);
     file.setDirectWriteFallback(true);
 
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+    // The UTF-8 encoder writes large chunks of its own, which do not need
+    // to be buffered again.
+    QIODevice::OpenMode mode = QIODevice::WriteOnly | QIODevice::Truncate;
+
+    if (isUtf8(encoding)) {
+        mode |= QIODevice::Unbuffered;
+    } else {
+        mode |= QIODevice::Text;
+    }
+
+    if (!file.open(mode)) {
         return file.errorString();
     }
 
     // Write contents to disk.
-    QTextStream stream(&file);
+    if (!writeText(file, text, encoding) || (QFile::NoError != file.error())) {
+        QString error = file.errorString();
+        file.cancelWriting();
+        return error;
+    }
+
+#ifdef Q_OS_UNIX
+    // QSaveFile only flushes the file data when committing.  Text mode
+    // writes are buffered, so flush them to the file before syncing it.
+    if (AsyncTextWriter::SyncAll == durability) {
+        file.flush();
+        ::fsync(file.handle());
+    }
+#endif
+
+    // Commit changes (and close the file).  All done!
+    if (!file.commit()) {
+        return file.errorString();
+    }
+
+#ifdef Q_OS_UNIX
+    if (AsyncTextWriter::SyncAll == durability) {
+        syncDirectory(fileName);
+    }
+#endif
+
+    return QString();
+}
+
+bool AsyncTextWriterPrivate::writeText(QFileDevice &file,
+    const QString &text,
+    AsyncTextWriter::Encoding encoding)
+{
+    if (!isUtf8(encoding)) {
+        QTextStream stream(&file);
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    stream.setCodec(encoding);
+        stream.setCodec(encoding);
 #else
-    stream.setEncoding(encoding);
+        stream.setEncoding(encoding);
 #endif
 
-    stream << text;
+        stream << text;
+        stream.flush();
+        return QTextStream::Ok == stream.status();
+    }
 
-    if (QFile::NoError != file.error()) {
-        file.cancelWriting();
-        return file.errorString();
+#ifdef Q_OS_WIN
+    bool crlf = true;
+#else
+    bool crlf = false;
+#endif
+
+    QByteArray buffer(3 * qMin(text.length(), UTF8_CHUNK_LENGTH), Qt::Uninitialized);
+    const QChar *data = text.constData();
+    int position = 0;
+
+    while (position < text.length()) {
+        int length = qMin(text.length() - position, UTF8_CHUNK_LENGTH);
+
+        // Keep surrogate pairs together.
+        if ((length > 1) && ((position + length) < text.length())
+                && data[position + length - 1].isHighSurrogate()) {
+            length--;
+        }
+
+        int size = encodeUtf8(data + position, length, buffer.data(), crlf);
+
+        if (file.write(buffer.constData(), size) != size) {
+            return false;
+        }
+
+        position += length;
     }
 
-    // Commit changes (and close the file).  All done!
-    file.commit();
-    return QString();
+    return true;
+}
+
+int AsyncTextWriterPrivate::encodeUtf8(const QChar *text, int length, char *buffer, bool crlf)
+{
+    const ushort *src = reinterpret_cast<const ushort *>(text);
+    uchar *dst = reinterpret_cast<uchar *>(buffer);
+    int i = 0;
+
+    while (i < length) {
+#ifdef ASYNC_TEXT_WRITER_SSE2
+        // Copy runs of ASCII eight code units at a time, narrowing them to
+        // bytes, until a code unit that needs more care shows up.
+        const __m128i nonAscii = _mm_set1_epi16(short(0xff80));
+        const __m128i lineFeed = _mm_set1_epi16('\n');
+        const __m128i zero = _mm_setzero_si128();
+
+        while ((i + 8) <= length) {
+            __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(units, nonAscii), zero);
+
+            if (crlf) {
+                ascii = _mm_andnot_si128(_mm_cmpeq_epi16(units, lineFeed), ascii);
+            }
+
+            if (0xffff != _mm_movemask_epi8(ascii)) {
+                break;
+            }
+
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_packus_epi16(units, units));
+            dst += 8;
+            i += 8;
+        }
+
+        if (i >= length) {
+            break;
+        }
+#endif
+        uint c = src[i++];
+
+        if (c < 0x80) {
+            if (crlf && ('\n' == c)) {
+                *dst++ = '\r';
+            }
+
+            *dst++ = uchar(c);
+        } else if (c < 0x800) {
+            *dst++ = uchar(0xc0 | (c >> 6));
+            *dst++ = uchar(0x80 | (c & 0x3f));
+        } else {
+            if (QChar::isSurrogate(c)) {
+                if (QChar::isHighSurrogate(c) && (i < length) && QChar::isLowSurrogate(src[i])) {
+                    c = QChar::surrogateToUcs4(ushort(c), src[i++]);
+                    *dst++ = uchar(0xf0 | (c >> 18));
+                    *dst++ = uchar(0x80 | ((c >> 12) & 0x3f));
+                    *dst++ = uchar(0x80 | ((c >> 6) & 0x3f));
+                    *dst++ = uchar(0x80 | (c & 0x3f));
+                    continue;
+                }
+
+                c = QChar::ReplacementCharacter;
+            }
+
+            *dst++ = uchar(0xe0 | (c >> 12));
+            *dst++ = uchar(0x80 | ((c >> 6) & 0x3f));
+            *dst++ = uchar(0x80 | (c & 0x3f));
+        }
+    }
+
+    return int(dst - reinterpret_cast<uchar *>(buffer));
+}
+
+bool AsyncTextWriterPrivate::isUtf8(AsyncTextWriter::Encoding encoding)
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    // 106 is the IANA MIBenum for UTF-8.
+    return (nullptr != encoding) && (106 == encoding->mibEnum());
+#else
+    return QStringConverter::Utf8 == encoding;
+#endif
 }
 
+#ifdef Q_OS_UNIX
+bool AsyncTextWriterPrivate::replaceWithoutSync(const QString &text,
+    const QString &fileName,
+    AsyncTextWriter::Encoding encoding,
+    QString &error)
+{
+    QFileInfo info(fileName);
+
+    // Leave new files to QSaveFile, which creates them with the default
+    // permissions for the umask, and read-only files and symbolic links,
+    // which it reports as errors and writes through, respectively.
+    if (!info.exists() || !info.isWritable() || info.isSymLink()) {
+        return false;
+    }
+
+    QTemporaryFile file(info.absolutePath() + "/." + info.fileName() + ".XXXXXX");
+
+    if (!file.open()) {
+        return false;
+    }
+
+    file.setPermissions(info.permissions());
+
+    if (!writeText(file, text, encoding) || !file.flush()) {
+        error = file.errorString();
+        return true;
+    }
+
+    if (0 != ::rename(QFile::encodeName(file.fileName()).constData(),
+            QFile::encodeName(info.absoluteFilePath()).constData())) {
+        error = QString::fromLocal8Bit(strerror(errno));
+        return true;
+    }
+
+    file.setAutoRemove(false);
+    error = QString();
+    return true;
+}
+
+void AsyncTextWriterPrivate::syncDirectory(const QString &fileName)
+{
+    QByteArray path = QFile::encodeName(QFileInfo(fileName).absolutePath());
+    int fd = ::open(path.constData(), O_RDONLY);
+
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+#endif
+
 void AsyncTextWriterPrivate::onWriteCompleted()
 {
     Q_Q(AsyncTextWriter);
 
-    QString err = this->writeFutureWatcher->result();
+    QPair<QString, QString> result = this->writeFutureWatcher->result();
+    QString err = result.first;
 
     this->writeInProgress = false;
+    this->lastLatency = this->runningTimer.elapsed();
+
+    // Start the pending write before notifying anyone, so that slots see
+    // a write in progress for as long as there is text left to write.
+    if (this->writePending) {
+        QString text = this->pendingText;
+
+        this->writePending = false;
+        this->pendingText = QString();
+        startWrite(text, this->pendingDurability, this->pendingTimer);
+    } else {
+        emit q->queueChanged(queueDepth(), this->lastLatency);
+    }
+
+    if (!result.second.isNull() && !result.second.isEmpty()) {
+        emit q->backupError(result.second);
+    }
 
     if (!err.isNull() && !err.isEmpty()) {
         emit q->writeError(err);
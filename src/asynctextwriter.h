@@ -35,6 +35,16 @@ namespace ghostwriter
 {
 /**
  * Writes document text asynchronously to a file.
+ *
+ * Writing never blocks the caller.  If a write is requested while another
+ * is still running, its text is held back and written as soon as the
+ * running write finishes.  Only the most recently requested text is held
+ * back, since each write replaces the whole file anyway.
+ *
+ * Optionally, the previous contents of the file are backed up before each
+ * write replaces them.  Backups are made on the same worker thread as the
+ * write, so they never hold up the caller and always capture the file as
+ * it was just before the write.
  */
 class AsyncTextWriterPrivate;
 class AsyncTextWriter : public QObject
@@ -51,6 +61,32 @@ public:
     typedef QStringConverter::Encoding Encoding;
 #endif
 
+    /**
+     * How hard a write tries to make sure the text has reached the disk
+     * before it is reported as complete.
+     */
+    enum Durability {
+        /**
+         * No explicit flush to disk.  The file is still replaced
+         * atomically, but a crash shortly after the write may lose it.
+         * Intended for autosaves, which will soon be repeated anyway.
+         */
+        NoSync,
+
+        /**
+         * The file contents are flushed to disk (fdatasync where
+         * available) before the file is replaced.  This is the default.
+         */
+        SyncData,
+
+        /**
+         * The file contents and metadata are flushed to disk (fsync)
+         * before the file is replaced, and the folder holding the file is
+         * flushed afterwards so that the replacement itself is durable.
+         */
+        SyncAll
+    };
+
     /**
      * Constructor with file path to which text will be written.
      */
@@ -83,19 +119,64 @@ public:
      */
     void setEncoding(Encoding encoding);
 
+    /**
+     * Returns the durability of subsequent writes.
+     */
+    Durability durability() const;
+
+    /**
+     * Sets the durability of subsequent writes.  The default durability
+     * if none is set with this method is SyncData.
+     */
+    void setDurability(Durability durability);
+
+    /**
+     * Returns the number of backups kept of the file.
+     */
+    int backupCount() const;
+
+    /**
+     * Sets the number of backups kept of the file.  Before each write, the
+     * file is backed up next to itself with the time of the backup (in UTC)
+     * and a ".backup" extension appended to its name, such as
+     * "notes.md.20220514-093012-123.backup".  The oldest backups beyond the
+     * given count are then removed.  Backups are copy-on-write clones on
+     * file systems that support them.  The default count if none is set
+     * with this method is 0, for no backups.
+     */
+    void setBackupCount(int count);
+
     /**
      * Returns true if a write is currently in progress, false otherwise.
      */
     bool writeInProgress() const;
 
     /**
-     * Waits for write to finish (if needed) before returning.
+     * Returns the number of writes that have yet to complete, which is
+     * the running write, if any, plus the one waiting for it, if any.
+     */
+    int queueDepth() const;
+
+    /**
+     * Returns the time taken by the last completed write in milliseconds,
+     * from the call to write() until the file was committed, or -1 if no
+     * write has completed yet.
+     */
+    qint64 lastLatency() const;
+
+    /**
+     * Waits for the running write and the write waiting for it, if any,
+     * to finish before returning.  The event loop is not run while
+     * waiting, and the signals reporting the outcome of the writes are
+     * emitted before this method returns.
      */
     void waitForFinished();
 
     /**
      * Writes the given text to the file.  Note: Previous contents of the file
-     * will be replaced.
+     * will be replaced.  Returns immediately.  If a write is already in
+     * progress, the text replaces any text still waiting to be written,
+     * and is written once the write in progress finishes.
      */
     bool write(const QString &text);
 
@@ -112,6 +193,21 @@ signals:
      */
     void writeError(const QString &errorString);
 
+    /**
+     * Emitted when the file could not be backed up before a write.  The
+     * write still goes ahead.  The error description will be set in the
+     * errorString parameter.
+     */
+    void backupError(const QString &errorString);
+
+    /**
+     * Emitted whenever a write is requested, started or completed, with
+     * the number of writes yet to complete and the latency of the last
+     * completed write in milliseconds (or -1 if none has completed yet).
+     * Intended for showing save progress in the status bar.
+     */
+    void queueChanged(int queueDepth, qint64 lastLatency);
+
 private:
     QScopedPointer<AsyncTextWriterPrivate> d_ptr;
 };
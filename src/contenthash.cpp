@@ -0,0 +1,123 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QByteArray>
+#include <QtEndian>
+
+#include "contenthash.h"
+
+namespace ghostwriter
+{
+static const quint64 Prime1 = Q_UINT64_C(11400714785074694791);
+static const quint64 Prime2 = Q_UINT64_C(14029467366897019727);
+static const quint64 Prime3 = Q_UINT64_C(1609587929392839161);
+static const quint64 Prime4 = Q_UINT64_C(9650029242287828579);
+static const quint64 Prime5 = Q_UINT64_C(2870177450012600261);
+
+static inline quint64 rotateLeft(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline quint64 round64(quint64 accumulator, quint64 input)
+{
+    accumulator += input * Prime2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * Prime1;
+}
+
+static inline quint64 mergeRound(quint64 accumulator, quint64 value)
+{
+    accumulator ^= round64(0, value);
+    return (accumulator * Prime1) + Prime4;
+}
+
+quint64 ContentHash::hash(const char *data, qint64 length, quint64 seed)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    const uchar *end = p + length;
+    quint64 result;
+
+    // Consume the input in stripes of 32 bytes, four lanes at a time.
+    if (length >= 32) {
+        const uchar *limit = end - 32;
+        quint64 v1 = seed + Prime1 + Prime2;
+        quint64 v2 = seed + Prime2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - Prime1;
+
+        do {
+            v1 = round64(v1, qFromLittleEndian<quint64>(p));
+            v2 = round64(v2, qFromLittleEndian<quint64>(p + 8));
+            v3 = round64(v3, qFromLittleEndian<quint64>(p + 16));
+            v4 = round64(v4, qFromLittleEndian<quint64>(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        result = rotateLeft(v1, 1) + rotateLeft(v2, 7)
+            + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        result = mergeRound(result, v1);
+        result = mergeRound(result, v2);
+        result = mergeRound(result, v3);
+        result = mergeRound(result, v4);
+    } else {
+        result = seed + Prime5;
+    }
+
+    result += quint64(length);
+
+    while ((p + 8) <= end) {
+        result ^= round64(0, qFromLittleEndian<quint64>(p));
+        result = (rotateLeft(result, 27) * Prime1) + Prime4;
+        p += 8;
+    }
+
+    if ((p + 4) <= end) {
+        result ^= quint64(qFromLittleEndian<quint32>(p)) * Prime1;
+        result = (rotateLeft(result, 23) * Prime2) + Prime3;
+        p += 4;
+    }
+
+    while (p < end) {
+        result ^= quint64(*p) * Prime5;
+        result = rotateLeft(result, 11) * Prime1;
+        p++;
+    }
+
+    // Avalanche.
+    result ^= result >> 33;
+    result *= Prime2;
+    result ^= result >> 29;
+    result *= Prime3;
+    result ^= result >> 32;
+
+    return result;
+}
+
+quint64 ContentHash::hash(const QByteArray &data)
+{
+    return hash(data.constData(), data.size());
+}
+
+quint64 ContentHash::hash(const QString &text)
+{
+    return hash(reinterpret_cast<const char *>(text.constData()),
+        qint64(text.size()) * qint64(sizeof(QChar)));
+}
+} // namespace ghostwriter
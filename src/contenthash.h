@@ -0,0 +1,55 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <QString>
+#include <QtGlobal>
+
+namespace ghostwriter
+{
+/**
+ * Fast, non-cryptographic 64-bit hash of file and document contents
+ * (XXH64 from the xxHash family), used to tell whether the contents
+ * have changed without comparing them in full.  Hashing runs at several
+ * gigabytes per second, so even very large documents hash in a few
+ * milliseconds.
+ */
+class ContentHash
+{
+public:
+    /**
+     * Returns the hash of the given bytes.
+     */
+    static quint64 hash(const char *data, qint64 length, quint64 seed = 0);
+
+    /**
+     * Returns the hash of the given bytes.
+     */
+    static quint64 hash(const QByteArray &data);
+
+    /**
+     * Returns the hash of the given text's UTF-16 code units.
+     */
+    static quint64 hash(const QString &text);
+};
+} // namespace ghostwriter
+
+#endif // CONTENT_HASH_H
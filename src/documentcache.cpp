@@ -0,0 +1,163 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <climits>
+
+#include <QCache>
+#include <QDateTime>
+#include <QFileInfo>
+
+#include "documentcache.h"
+
+namespace ghostwriter
+{
+/*
+* A cached document, along with the state of its file when it was cached.
+*/
+class CachedDocument
+{
+public:
+    CachedDocument() : size(-1)
+    {
+        ;
+    }
+
+    ~CachedDocument()
+    {
+        if (nullptr != document.ast) {
+            delete document.ast;
+        }
+    }
+
+    DocumentCache::Document document;
+    QDateTime lastModified;
+    qint64 size;
+};
+
+class DocumentCachePrivate
+{
+public:
+    DocumentCachePrivate(qint64 capacity)
+        : documents(int(qMin(capacity, qint64(INT_MAX))))
+    {
+        ;
+    }
+
+    ~DocumentCachePrivate()
+    {
+        ;
+    }
+
+    /*
+    * Cached documents by file path, with their estimated size in bytes
+    * as their cost.
+    */
+    QCache<QString, CachedDocument> documents;
+
+    /*
+    * Returns an estimate of the number of bytes of memory held by the
+    * given document.
+    */
+    static qint64 memorySize(const DocumentCache::Document &document);
+};
+
+DocumentCache::DocumentCache(qint64 capacity)
+    : d_ptr(new DocumentCachePrivate(capacity))
+{
+    ;
+}
+
+DocumentCache::~DocumentCache()
+{
+    ;
+}
+
+void DocumentCache::insert(const QString &filePath, const Document &document)
+{
+    Q_D(DocumentCache);
+
+    QFileInfo fileInfo(filePath);
+    CachedDocument *cached = new CachedDocument();
+
+    cached->document = document;
+    cached->lastModified = fileInfo.lastModified();
+    cached->size = fileInfo.size();
+
+    // The cache deletes the document right away if it is too large.
+    d->documents.insert
+    (
+        fileInfo.absoluteFilePath(),
+        cached,
+        int(qMin(DocumentCachePrivate::memorySize(document), qint64(INT_MAX)))
+    );
+}
+
+bool DocumentCache::take(const QString &filePath, Document &document)
+{
+    Q_D(DocumentCache);
+
+    QFileInfo fileInfo(filePath);
+    CachedDocument *cached = d->documents.take(fileInfo.absoluteFilePath());
+
+    if (nullptr == cached) {
+        return false;
+    }
+
+    bool unchanged = fileInfo.exists()
+        && (fileInfo.lastModified() == cached->lastModified)
+        && (fileInfo.size() == cached->size);
+
+    if (unchanged) {
+        document = cached->document;
+        cached->document.ast = nullptr;
+    }
+
+    delete cached;
+    return unchanged;
+}
+
+void DocumentCache::clear()
+{
+    Q_D(DocumentCache);
+
+    d->documents.clear();
+}
+
+qint64 DocumentCachePrivate::memorySize(const DocumentCache::Document &document)
+{
+    qint64 size = qint64(document.text.size()) * qint64(sizeof(QChar));
+
+    if (nullptr != document.ast) {
+        size += document.ast->memorySize();
+    }
+
+    size += qint64(document.blockStatistics.size())
+        * qint64(sizeof(DocumentCache::BlockStatistics));
+    size += qint64(document.spelling.checked.size())
+        * qint64(sizeof(bool) + sizeof(QStringList));
+
+    for (const QStringList &words : document.spelling.misspelledWords) {
+        for (const QString &word : words) {
+            size += qint64(word.size()) * qint64(sizeof(QChar));
+        }
+    }
+
+    return size;
+}
+} // namespace ghostwriter
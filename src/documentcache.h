@@ -0,0 +1,123 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef DOCUMENT_CACHE_H
+#define DOCUMENT_CACHE_H
+
+#include <QScopedPointer>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+#include "markdownast.h"
+#include "spelling/spellcheckdecorator.h"
+
+namespace ghostwriter
+{
+/**
+ * Least recently used cache of documents that have been closed, holding
+ * their text along with everything derived from it, so that reopening
+ * one of them needs neither reading, parsing, counting nor spell
+ * checking it again from scratch.
+ *
+ * Documents are cached by file path, and are only handed back if the
+ * file's modification time and size are the same as when the document
+ * was cached.  The cache is bounded by an estimate of the memory held by
+ * its documents, evicting the least recently cached ones first.
+ */
+class DocumentCachePrivate;
+class DocumentCache
+{
+    Q_DECLARE_PRIVATE(DocumentCache)
+    Q_DISABLE_COPY(DocumentCache)
+
+public:
+    /**
+     * Statistics of a block of text, as kept in its TextBlockData.
+     */
+    struct BlockStatistics
+    {
+        int wordCount;
+        int alphaNumericCharacterCount;
+        int sentenceCount;
+        int lixLongWordCount;
+    };
+
+    /**
+     * A closed document's text and what was derived from it.
+     */
+    struct Document
+    {
+        Document() : ast(nullptr) { }
+
+        QString text;
+
+        /**
+         * Syntax tree of the text, or null.  Owned by the cache while the
+         * document is cached.
+         */
+        MarkdownAST *ast;
+
+        /**
+         * Statistics of each block of the text, or empty if they were not
+         * all counted.
+         */
+        QVector<BlockStatistics> blockStatistics;
+
+        SpellCheckDecorator::Results spelling;
+    };
+
+    /**
+     * Constructor.  Takes the number of bytes of memory the cached
+     * documents may hold.
+     */
+    DocumentCache(qint64 capacity);
+
+    /**
+     * Destructor.
+     */
+    ~DocumentCache();
+
+    /**
+     * Caches the document for the file at the given path, whose contents
+     * on disk must be the document's text.  Takes ownership of the
+     * document's syntax tree.  Replaces any document already cached for
+     * the file.  Documents too large for the cache are not cached.
+     */
+    void insert(const QString &filePath, const Document &document);
+
+    /**
+     * Removes the document for the file at the given path from the cache
+     * and returns true if it was cached and the file has not changed
+     * since, in which case ownership of the document's syntax tree passes
+     * to the caller.
+     */
+    bool take(const QString &filePath, Document &document);
+
+    /**
+     * Removes all documents from the cache.
+     */
+    void clear();
+
+private:
+    QScopedPointer<DocumentCachePrivate> d_ptr;
+};
+} // namespace ghostwriter
+
+#endif // DOCUMENT_CACHE_H
@@ -19,29 +19,63 @@
 
 #include <QApplication>
 #include <QDir>
+#include <QEventLoop>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
+#include <QFutureWatcher>
 #include <QMessageBox>
 #include <QPair>
+#include <QScrollBar>
 #include <QString>
 #include <QStandardPaths>
 #include <QTextDocument>
-#include <QTextStream>
 #include <QTimer>
+#include <QtConcurrentRun>
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+#include <QTextCodec>
+#else
+#include <QStringDecoder>
+#endif
 
 #include "asynctextwriter.h"
+#include "contenthash.h"
+#include "documentcache.h"
 #include "documenthistory.h"
 #include "documentmanager.h"
+#include "editjournal.h"
+#include "linediff.h"
 #include "exportdialog.h"
 #include "exporter.h"
 #include "exporterfactory.h"
+#include "largefilepager.h"
+#include "lineindex.h"
 #include "markdowndocument.h"
 #include "markdowneditor.h"
 #include "messageboxhelper.h"
+#include "textblockdata.h"
 #include "themerepository.h"
 
+// Smallest journal worth compacting, in bytes.
+#define GW_JOURNAL_MIN_COMPACT_SIZE 65536
+
+// Files of at least this many bytes are mapped into memory to be decoded.
+#define GW_MAP_FILE_SIZE (1024 * 1024)
+
+// Number of characters of a file shown as soon as it is opened, which is
+// several screenfuls, and the number appended at a time after that.
+#define GW_LOAD_FIRST_CHUNK_LENGTH 16384
+#define GW_LOAD_CHUNK_LENGTH (256 * 1024)
+
+// Files of at least this many bytes are shown one part at a time rather
+// than loaded as a whole.
+#define GW_LARGE_FILE_SIZE (64 * 1024 * 1024)
+
+// Number of bytes of memory that recently closed documents may hold.
+#define GW_DOCUMENT_CACHE_SIZE (64 * 1024 * 1024)
+
 namespace ghostwriter
 {
 class DocumentManagerPrivate
@@ -54,7 +88,8 @@ public:
     DocumentManagerPrivate
     (
         DocumentManager *q_ptr
-    ) : q_ptr(q_ptr)
+    ) : q_ptr(q_ptr),
+        cache(GW_DOCUMENT_CACHE_SIZE)
     {
         ;
     }
@@ -74,8 +109,44 @@ public:
     QFileSystemWatcher *fileWatcher;
     bool fileHistoryEnabled;
     bool createBackupOnSave;
+    int backupCount;
     AsyncTextWriter *writer;
 
+    /*
+    * Journal of the edits made since the document was last loaded or
+    * saved, used to recover them after a crash.
+    */
+    EditJournal *journal;
+    bool journalEnabled;
+
+    /*
+    * Text of the last save, which the journal is restarted against once
+    * the save has made it to disk.
+    */
+    QString journalBaseText;
+
+    /*
+    * Pages the file into the document one part at a time if it is too
+    * large to be loaded as a whole, otherwise null.
+    */
+    LargeFilePager *pager;
+
+    /*
+    * Recently closed documents, along with what was derived from their
+    * text, for reopening them without starting from scratch.
+    */
+    DocumentCache cache;
+    SpellCheckDecorator *spelling;
+
+    /*
+    * Hash of the file contents as last loaded or saved (including a save
+    * still in progress), used to skip saving unchanged text and to ignore
+    * file change notifications that did not change the contents.  Only
+    * meaningful when diskHashValid is true.
+    */
+    quint64 diskHash;
+    bool diskHashValid;
+
     /*
     * This flag is used to prevent notifying the user that the document
     * was modified when the user is the one who modified it by saving.
@@ -83,6 +154,13 @@ public:
     */
     bool saveInProgress;
 
+    /*
+    * True while a file is being opened.  The event loop keeps running in
+    * the meantime, so anything that would replace or save the document is
+    * ignored until the file is fully loaded.
+    */
+    bool loadInProgress;
+
     /*
     * This timer's timeout signal is connected to the autoSaveFile() slot,
     * which saves the document if it can be saved and has been modified.
@@ -108,10 +186,62 @@ public:
     void onFileChangedExternally(const QString &path);
 
     /*
-    * Loads the document with the file contents at the given path.
+    * Loads the document with the file contents at the given path.  The
+    * file is read on a worker thread, and the beginning of it is shown
+    * before the rest is appended piece by piece.
     */
     bool loadFile(const QString &filePath);
 
+    /*
+    * Replaces the document text with the file contents on disk by editing
+    * only the lines that differ, as a single step that can be undone.
+    * Unlike loadFile(), this keeps the undo history, the cursor and
+    * scroll positions, and the highlighting and spell checking of the
+    * blocks outside of the changed lines.
+    */
+    bool reloadFile();
+
+    /*
+    * Reads and decodes the text of the file at the given path, returning
+    * false and setting error if the file could not be read.  Line endings
+    * are converted to '\n', as they are in the document.
+    */
+    static bool readFile(const QString &filePath, QString &text, QString &error);
+
+    /*
+    * Waits for the given job on a worker thread to finish while the
+    * window keeps repainting, and returns its result.
+    */
+    static bool waitForWorker(const QFuture<bool> &future);
+
+    /*
+    * Caches the document before it is closed or replaced, if its text is
+    * the same as the file's contents.
+    */
+    void cacheDocument();
+
+    /*
+    * Stops paging a large file, if one is being paged.
+    */
+    void closePager();
+
+    /*
+    * Returns the position of the text cursor in the file.
+    */
+    int cursorPosition() const;
+
+    /*
+    * Moves the text cursor to the given position in the file.
+    */
+    void navigateDocument(int position);
+
+    /*
+    * Returns the length of the piece of text starting at the given
+    * position to append to the document next, which is at most
+    * maxLength, and ends after a line break if there is one.
+    */
+    static int chunkLength(const QString &text, int position, int maxLength);
+
     /*
     * Sets the file path for the document, such that the file will be
     * monitored for external changes made to it, and the display name
@@ -146,14 +276,6 @@ public:
         bool createBackup
     ) const;
 
-    /*
-    * Creates a backup file with a ".backup" extension of the file having
-    * the specified path.  Note that this method is intended to be run in
-    * a separate thread from the main Qt event loop, and should thus never
-    * interact with any widgets.
-    */
-    void backupFile(const QString &filePath) const;
-
     /*
     * Handles autosave operation upon autosave timer expiration.
     */
@@ -170,6 +292,14 @@ public:
     * draft location.
     */
     void createDraft();
+
+    /*
+    * Starts journaling the edits to the document as it is on disk.  If
+    * recover is true, the user is first offered to restore any edits
+    * left in the journal by a previous session that did not close the
+    * document.
+    */
+    void startJournal(bool recover);
 };
 
 const QString DocumentManagerPrivate::FILE_CHOOSER_FILTER =
@@ -190,9 +320,16 @@ DocumentManager::DocumentManager
     d->editor = editor;
     d->fileHistoryEnabled = true;
     d->createBackupOnSave = true;
+    d->backupCount = 1;
     d->saveInProgress = false;
+    d->loadInProgress = false;
     d->autoSaveEnabled = false;
     d->documentModifiedNotifVisible = false;
+    d->journalEnabled = false;
+    d->diskHash = 0;
+    d->diskHashValid = false;
+    d->pager = nullptr;
+    d->spelling = nullptr;
 
     d->draftLocation =
         QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
@@ -201,6 +338,7 @@ DocumentManager::DocumentManager
     d->document = (MarkdownDocument *) editor->document();
 
     d->writer = new AsyncTextWriter(d->document->filePath());
+    d->journal = new EditJournal(d->document, this);
 
     // Markdown files need to be in UTF-8, since most Markdown processors
     // (i.e., Pandoc, et. al.) can only read UTF-8 encoded text files.
@@ -210,16 +348,29 @@ DocumentManager::DocumentManager
     d->writer->setEncoding(QStringConverter::Utf8);
 #endif
 
+    // Saves the user asked for should survive a crash right afterwards.
+    d->writer->setDurability(AsyncTextWriter::SyncAll);
+    d->writer->setBackupCount(d->backupCount);
+
     this->connect(
         d->writer,
         &AsyncTextWriter::writeComplete,
         [d]() {
-            d->saveInProgress = false;
+            // A newer save may already be on its way to disk.
+            d->saveInProgress = d->writer->writeInProgress();
             d->document->setTimestamp(QDateTime::currentDateTime());
 
             if (!d->fileWatcher->files().contains(d->writer->fileName())) {
                 d->fileWatcher->addPath(d->writer->fileName());
             }
+
+            // Only the last of several coalesced saves matches the file.
+            if (d->journalEnabled && !d->saveInProgress
+                    && !d->journalBaseText.isNull()) {
+                d->journal->start(d->writer->fileName(), d->draftLocation,
+                    d->journalBaseText);
+                d->journalBaseText = QString();
+            }
         }
     );
 
@@ -235,7 +386,22 @@ DocumentManager::DocumentManager
                 );
             }
 
-            d->saveInProgress = false;
+            d->saveInProgress = d->writer->writeInProgress();
+
+            // The file now holds something other than the text hashed.
+            d->diskHashValid = false;
+        }
+    );
+
+    this->connect(
+        d->writer,
+        &AsyncTextWriter::backupError,
+        [d](const QString &err) {
+            MessageBoxHelper::critical(
+                d->editor,
+                QObject::tr("File backup failed"),
+                err
+            );
         }
     );
 
@@ -325,6 +491,44 @@ void DocumentManager::setFileBackupEnabled(bool enabled)
     Q_D(DocumentManager);
     
     d->createBackupOnSave = enabled;
+    d->writer->setBackupCount(enabled ? d->backupCount : 0);
+}
+
+int DocumentManager::fileBackupCount() const
+{
+    Q_D(const DocumentManager);
+
+    return d->backupCount;
+}
+
+void DocumentManager::setFileBackupCount(int count)
+{
+    Q_D(DocumentManager);
+
+    d->backupCount = qMax(1, count);
+    d->writer->setBackupCount(d->createBackupOnSave ? d->backupCount : 0);
+}
+
+bool DocumentManager::editJournalEnabled() const
+{
+    Q_D(const DocumentManager);
+
+    return d->journalEnabled;
+}
+
+void DocumentManager::setEditJournalEnabled(bool enabled)
+{
+    Q_D(DocumentManager);
+
+    d->journalEnabled = enabled;
+
+    if (!enabled) {
+        d->journal->stop();
+    } else if (!d->journal->isActive() && !d->document->isModified()) {
+        // Otherwise, the journal starts with the next save, since the
+        // text on disk is not at hand.
+        d->startJournal(false);
+    }
 }
 
 void DocumentManager::setDraftLocation(const QString &directory) 
@@ -351,6 +555,10 @@ void DocumentManager::open(const QString &filePath)
 {
     Q_D(DocumentManager);
     
+    if (d->loadInProgress) {
+        return;
+    }
+
     if (d->checkSaveChanges()) {
         QString path;
 
@@ -388,7 +596,7 @@ void DocumentManager::open(const QString &filePath)
             }
 
             QString oldFilePath = d->document->filePath();
-            int oldCursorPosition = d->editor->textCursor().position();
+            int oldCursorPosition = d->cursorPosition();
             bool oldFileWasNew = d-> document->isNew();
 
             if (!d->loadFile(path)) {
@@ -397,7 +605,7 @@ void DocumentManager::open(const QString &filePath)
                 //
                 return;
             } else if (oldFilePath == d->document->filePath()) {
-                d->editor->navigateDocument(oldCursorPosition);
+                d->navigateDocument(oldCursorPosition);
             } else if (d->fileHistoryEnabled) {
                 if (!oldFileWasNew) {
                     DocumentHistory history;
@@ -408,6 +616,8 @@ void DocumentManager::open(const QString &filePath)
                     );
                 }
             }
+
+            d->startJournal(true);
         }
     }
 }
@@ -435,7 +645,7 @@ void DocumentManager::reload()
 {
     Q_D(DocumentManager);
     
-    if (!d->document->isNew()) {
+    if (!d->document->isNew() && !d->loadInProgress) {
         if (d->document->isModified()) {
             // Prompt user if he wants to save changes.
             int response =
@@ -453,12 +663,14 @@ void DocumentManager::reload()
             }
         }
 
-        QTextCursor cursor = d->editor->textCursor();
-        int pos = cursor.position();
+        if (nullptr != d->pager) {
+            int position = d->cursorPosition();
 
-        if (d->loadFile(d->document->filePath())) {
-            cursor.setPosition(pos);
-            d->editor->setTextCursor(cursor);
+            if (d->loadFile(d->document->filePath())) {
+                d->navigateDocument(position);
+            }
+        } else if (d->reloadFile()) {
+            d->startJournal(false);
         }
     }
 }
@@ -467,6 +679,10 @@ void DocumentManager::rename()
 {
     Q_D(DocumentManager);
     
+    if (d->loadInProgress) {
+        return;
+    }
+
     if (d->document->isNew()) {
         saveAs();
     } else {
@@ -520,6 +736,15 @@ bool DocumentManager::save()
 {
     Q_D(DocumentManager);
     
+    if (d->loadInProgress) {
+        return false;
+    }
+
+    // Large files are only ever viewed, so there is nothing to save.
+    if (nullptr != d->pager) {
+        return true;
+    }
+
     if (d->document->isNew() || !d->checkPermissionsBeforeSave()) {
         return this->saveAs();
     } else {
@@ -532,6 +757,10 @@ bool DocumentManager::saveAs()
 {
     Q_D(DocumentManager);
     
+    if (d->loadInProgress || (nullptr != d->pager)) {
+        return false;
+    }
+
     QString startingDirectory = QString();
 
     if (!d->document->isNew()) {
@@ -560,6 +789,10 @@ bool DocumentManager::close()
 {
     Q_D(DocumentManager);
     
+    if (d->loadInProgress) {
+        return false;
+    }
+
     if (d->checkSaveChanges()) {
         if (d->writer->writeInProgress()) {
             d->writer->waitForFinished();
@@ -569,7 +802,7 @@ bool DocumentManager::close()
         // so we can store history information about it.
         //
         QString filePath = d->document->filePath();
-        int cursorPosition = d->editor->textCursor().position();
+        int cursorPosition = d->cursorPosition();
         bool documentIsNew = d->document->isNew();
 
         // Set up a new, untitled document.  Note that the document
@@ -587,6 +820,8 @@ bool DocumentManager::close()
         cursor.setPosition(0);
         d->editor->setTextCursor(cursor);
 
+        d->cacheDocument();
+        d->closePager();
         d->document->clear();
         d->document->clearUndoRedoStacks();
 
@@ -616,6 +851,12 @@ bool DocumentManager::close()
 void DocumentManager::exportFile()
 {
     Q_D(DocumentManager);
+
+    // Only the part of a large file being viewed is in the document, so
+    // exporting it would silently leave out the rest.
+    if (nullptr != d->pager) {
+        return;
+    }
     
     ExportDialog exportDialog(d->document);
 
@@ -625,12 +866,42 @@ void DocumentManager::exportFile()
     exportDialog.exec();
 }
 
+void DocumentManager::setSpellCheckDecorator(SpellCheckDecorator *decorator)
+{
+    Q_D(DocumentManager);
+
+    d->spelling = decorator;
+}
+
+QTextBlock DocumentManager::blockForLine(int line)
+{
+    Q_D(DocumentManager);
+
+    if (nullptr != d->pager) {
+        return d->pager->showLine(line);
+    }
+
+    return d->document->findBlockByNumber(line);
+}
+
+bool DocumentManager::isPaged() const
+{
+    Q_D(const DocumentManager);
+
+    return nullptr != d->pager;
+}
+
 void DocumentManagerPrivate::onFileChangedExternally(const QString &path)
 {
     Q_Q(DocumentManager);
 
     QFileInfo fileInfo(path);
 
+    // The file being replaced by the one being opened is of no interest.
+    if (loadInProgress) {
+        return;
+    }
+
     if (!fileInfo.exists()) {
         emit q->documentModifiedChanged(true);
 
@@ -663,6 +934,31 @@ void DocumentManagerPrivate::onFileChangedExternally(const QString &path)
             (fileInfo.lastModified() > document->timestamp()) &&
             !documentModifiedNotifVisible
         ) {
+            // Tools like git and file sync clients often rewrite or touch
+            // files without changing them.  Only bother the user if the
+            // contents really changed.
+            if (diskHashValid) {
+                QString text;
+                QString error;
+
+                if (readFile(path, text, error)
+                        && (ContentHash::hash(text) == diskHash)) {
+                    document->setTimestamp(fileInfo.lastModified());
+
+                    // Files replaced by renaming drop out of the watcher.
+                    if (!fileWatcher->files().contains(path)) {
+                        fileWatcher->addPath(path);
+                    }
+
+                    return;
+                }
+
+                // The file no longer holds the text last loaded or saved,
+                // whether or not the user reloads it, so saving the same
+                // text again must still write it.
+                diskHashValid = false;
+            }
+
             documentModifiedNotifVisible = true;
 
             int response =
@@ -688,17 +984,28 @@ void DocumentManagerPrivate::saveFile()
 {
     Q_Q(DocumentManager);
 
+    QString text = document->toPlainText();
+    quint64 hash = ContentHash::hash(text);
+
     document->setModified(false);
     emit q->documentModifiedChanged(false);
+
+    // Nothing to write if the file already holds (or is about to hold)
+    // the very same text.
+    if (diskHashValid && (hash == diskHash) && QFileInfo::exists(writer->fileName())) {
+        return;
+    }
+
     document->setTimestamp(QDateTime::currentDateTime());
     saveInProgress = true;
 
-    // If backup is enabled, back up the file first.
-    if (createBackupOnSave) {
-        backupFile(writer->fileName());
-    }
+    bool status = writer->write(text);
+    diskHash = hash;
+    diskHashValid = status;
 
-    bool status = writer->write(document->toPlainText());
+    if (status && journalEnabled) {
+        journalBaseText = text;
+    }
 
     if (!status) {
         MessageBoxHelper::critical(
@@ -716,12 +1023,56 @@ bool DocumentManagerPrivate::loadFile(const QString &filePath)
     Q_Q(DocumentManager);
 
     QFileInfo fileInfo(filePath);
-    QFile inputFile(filePath);
+    QString text;
+    QString error;
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    emit q->operationStarted(QObject::tr("opening %1").arg(filePath));
+
+    loadInProgress = true;
+    editor->setReadOnly(true);
+
+    // A recently closed document whose file has not changed since is
+    // restored along with everything derived from its text.
+    DocumentCache::Document cachedDocument;
+    bool cached = cache.take(filePath, cachedDocument);
+
+    if (cached) {
+        text = cachedDocument.text;
+    }
+
+    // Files too large to be loaded as a whole are only indexed, to be
+    // shown one part at a time.  Those that cannot be, such as files
+    // that are not UTF-8, are loaded as usual.
+    LineIndex *index = nullptr;
+
+    if (!cached && (fileInfo.size() >= GW_LARGE_FILE_SIZE)) {
+        index = new LineIndex();
+
+        if (!waitForWorker(QtConcurrent::run([index, filePath]() {
+                    QString indexError;
+                    return index->open(filePath, indexError);
+                }))) {
+            delete index;
+            index = nullptr;
+        }
+    }
+
+    // Read and decode the file on a worker thread, so that the window
+    // keeps repainting in the meantime.
+    if (!cached
+            && (nullptr == index)
+            && !waitForWorker(QtConcurrent::run([filePath, &text, &error]() {
+                    return readFile(filePath, text, error);
+                }))) {
+        loadInProgress = false;
+        editor->setReadOnly(false);
+        emit q->operationFinished();
+        QApplication::restoreOverrideCursor();
 
-    if (!inputFile.open(QIODevice::ReadOnly)) {
         MessageBoxHelper::critical(editor,
             QObject::tr("Could not read %1").arg(filePath),
-            inputFile.errorString()
+            error
         );
         return false;
     }
@@ -736,54 +1087,95 @@ bool DocumentManagerPrivate::loadFile(const QString &filePath)
     cursor.setPosition(0);
     editor->setTextCursor(cursor);
 
+    if (QFileInfo(document->filePath()) != fileInfo) {
+        cacheDocument();
+    }
+
     document->clearUndoRedoStacks();
     document->setUndoRedoEnabled(false);
+    closePager();
     document->clear();
 
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-    emit q->operationStarted(QObject::tr("opening %1").arg(filePath));
-    QTextStream inStream(&inputFile);
+    setFilePath(filePath);
 
-    // Markdown files need to be in UTF-8 format, so assume that is
-    // what the user is opening by default.  Enable autodetection
-    // of of UTF-16 or UTF-32 BOM in case the file isn't UTF-8 encoded.
-    //
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    inStream.setCodec("UTF-8");
-#else
-    inStream.setEncoding(QStringConverter::Utf8);
-#endif
-    inStream.setAutoDetectUnicode(true);
+    if (nullptr != index) {
+        pager = new LargeFilePager(editor, index, q);
+    }
 
-    QString text = inStream.readAll();
+    // Show the beginning of the file straight away, parsed and highlighted
+    // as usual.  The rest is appended piece by piece, leaving whatever is
+    // derived from the whole document until it is all there.
+    int length = chunkLength(text, 0, GW_LOAD_FIRST_CHUNK_LENGTH);
 
-    if (QFile::NoError != inputFile.error()) {
-        MessageBoxHelper::critical(editor,
-            QObject::tr("Could not read %1").arg(filePath),
-            inputFile.errorString()
-        );
+    if (cached) {
+        length = int(text.length());
+        document->setLoading(true);
+        editor->setPlainText(text);
+        editor->navigateDocument(0);
 
-        inputFile.close();
-        return false;
+        if (cachedDocument.blockStatistics.size() == document->blockCount()) {
+            int i = 0;
+
+            for (QTextBlock block = document->begin(); block.isValid(); block = block.next()) {
+                const DocumentCache::BlockStatistics &statistics =
+                    cachedDocument.blockStatistics[i++];
+                TextBlockData *blockData = new TextBlockData(document, block);
+
+                blockData->wordCount = statistics.wordCount;
+                blockData->alphaNumericCharacterCount = statistics.alphaNumericCharacterCount;
+                blockData->sentenceCount = statistics.sentenceCount;
+                blockData->lixLongWordCount = statistics.lixLongWordCount;
+                block.setUserData(blockData);
+            }
+        }
+
+        document->setMarkdownAST(cachedDocument.ast);
+        document->setLoading(false);
+
+        if (nullptr != spelling) {
+            spelling->restoreResults(cachedDocument.spelling);
+        }
+    } else if (nullptr == pager) {
+        editor->setPlainText(text.left(length));
+        editor->navigateDocument(0);
     }
 
-    inputFile.close();
-    
-    setFilePath(filePath);
-    editor->setPlainText(text);
-    editor->navigateDocument(0);
     emit q->operationUpdate();
 
+    if (length < text.length()) {
+        QTextCursor appendCursor(document);
+        appendCursor.movePosition(QTextCursor::End);
+        document->setLoading(true);
+
+        // The last block is about to be appended to, so its statistics no
+        // longer hold.
+        document->lastBlock().setUserData(nullptr);
+
+        for (int position = length; position < text.length(); position += length) {
+            length = chunkLength(text, position, GW_LOAD_CHUNK_LENGTH);
+            appendCursor.insertText(text.mid(position, length));
+
+            emit q->operationUpdate
+            (
+                QObject::tr("opening %1 (%2%)")
+                    .arg(filePath)
+                    .arg((qint64(position + length) * 100) / text.length())
+            );
+        }
+
+        document->setLoading(false);
+    }
+
     document->setUndoRedoEnabled(true);
 
     if (fileHistoryEnabled) {
         DocumentHistory history;
-        editor->navigateDocument(history.cursorPosition(filePath));
+        navigateDocument(history.cursorPosition(filePath));
     } else {
-        editor->navigateDocument(0);
+        navigateDocument(0);
     }
 
-    editor->setReadOnly(false);
+    editor->setReadOnly(nullptr != pager);
 
     if (!fileInfo.isWritable()) {
         document->setReadOnly(true);
@@ -794,6 +1186,10 @@ bool DocumentManagerPrivate::loadFile(const QString &filePath)
     document->setModified(false);
     document->setTimestamp(fileInfo.lastModified());
 
+    // A large file is never saved, nor read as a whole to be compared.
+    diskHash = ContentHash::hash(text);
+    diskHashValid = (nullptr == pager);
+
     QString watchedFile;
 
     foreach (watchedFile, fileWatcher->files()) {
@@ -801,6 +1197,7 @@ bool DocumentManagerPrivate::loadFile(const QString &filePath)
     }
 
     fileWatcher->addPath(filePath);
+    loadInProgress = false;
     emit q->operationFinished();
     emit q->documentModifiedChanged(false);
     QApplication::restoreOverrideCursor();
@@ -811,6 +1208,253 @@ bool DocumentManagerPrivate::loadFile(const QString &filePath)
     return true;
 }
 
+bool DocumentManagerPrivate::reloadFile()
+{
+    Q_Q(DocumentManager);
+
+    QString filePath = document->filePath();
+    QFileInfo fileInfo(filePath);
+    QString text;
+    QString error;
+
+    // Read the file on a worker thread, as when loading it, so that the
+    // window keeps repainting in the meantime.
+    loadInProgress = true;
+    editor->setReadOnly(true);
+
+    bool status = waitForWorker(QtConcurrent::run([filePath, &text, &error]() {
+        return readFile(filePath, text, error);
+    }));
+
+    loadInProgress = false;
+    editor->setReadOnly(false);
+
+    if (!status) {
+        MessageBoxHelper::critical(editor,
+            QObject::tr("Could not read %1").arg(filePath),
+            error
+        );
+        return false;
+    }
+
+    QVector<LineDiff::Hunk> hunks =
+        LineDiff::compare(document->toPlainText(), text);
+
+    // The journal is restarted against the new text afterwards, so there
+    // is no point in recording each hunk.
+    journal->stop(true);
+
+    int scrollPosition = editor->verticalScrollBar()->value();
+    QTextCursor cursor(document);
+
+    // Apply every hunk in a single edit block, so that the document
+    // reports a single change spanning all of them.  The whole document
+    // is then parsed and its statistics counted once, rather than once
+    // per hunk.  Hunks are applied last to first to keep positions valid.
+    cursor.beginEditBlock();
+
+    for (int i = hunks.size() - 1; i >= 0; i--) {
+        const LineDiff::Hunk &hunk = hunks[i];
+
+        cursor.setPosition(hunk.oldPosition);
+        cursor.setPosition(hunk.oldPosition + hunk.oldLength, QTextCursor::KeepAnchor);
+        cursor.insertText(text.mid(hunk.newPosition, hunk.newLength));
+    }
+
+    cursor.endEditBlock();
+
+    editor->verticalScrollBar()->setValue(scrollPosition);
+
+    document->setReadOnly(!fileInfo.isWritable());
+    document->setModified(false);
+    document->setTimestamp(fileInfo.lastModified());
+    diskHash = ContentHash::hash(text);
+    diskHashValid = true;
+
+    if (!fileWatcher->files().contains(filePath)) {
+        fileWatcher->addPath(filePath);
+    }
+
+    emit q->documentModifiedChanged(false);
+    return true;
+}
+
+bool DocumentManagerPrivate::readFile(const QString &filePath,
+    QString &text,
+    QString &error)
+{
+    QFile inputFile(filePath);
+
+    if (!inputFile.open(QIODevice::ReadOnly)) {
+        error = inputFile.errorString();
+        return false;
+    }
+
+    // Large files are decoded straight from a mapping of the file rather
+    // than from a copy of its contents.
+    QByteArray buffer;
+    const char *data = nullptr;
+    qint64 size = inputFile.size();
+
+    if (size >= GW_MAP_FILE_SIZE) {
+        data = (const char *) inputFile.map(0, size);
+    }
+
+    if (nullptr == data) {
+        buffer = inputFile.readAll();
+
+        if (QFile::NoError != inputFile.error()) {
+            error = inputFile.errorString();
+            inputFile.close();
+            return false;
+        }
+
+        data = buffer.constData();
+        size = buffer.size();
+    }
+
+    // Markdown files need to be in UTF-8 format, so assume that is
+    // what the user is opening by default.  Enable autodetection
+    // of of UTF-16 or UTF-32 BOM in case the file isn't UTF-8 encoded.
+    //
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    QTextCodec *codec =
+        QTextCodec::codecForUtfText
+        (
+            QByteArray::fromRawData(data, int(size)),
+            QTextCodec::codecForName("UTF-8")
+        );
+
+    text = codec->toUnicode(data, int(size));
+#else
+    QStringDecoder decoder
+    (
+        QStringConverter::encodingForData(QByteArrayView(data, size))
+            .value_or(QStringConverter::Utf8)
+    );
+
+    text = decoder.decode(QByteArrayView(data, size));
+#endif
+
+    // The document turns every line ending into a block break, so convert
+    // them here for the text to be compared with the document's.
+    if (text.contains('\r')) {
+        text.replace("\r\n", "\n");
+        text.replace('\r', '\n');
+    }
+
+    inputFile.close();
+    return true;
+}
+
+bool DocumentManagerPrivate::waitForWorker(const QFuture<bool> &future)
+{
+    QFutureWatcher<bool> watcher;
+    QEventLoop loop;
+
+    QObject::connect(&watcher, &QFutureWatcherBase::finished,
+        &loop, &QEventLoop::quit);
+    watcher.setFuture(future);
+    loop.exec(QEventLoop::ExcludeUserInputEvents);
+
+    return watcher.result();
+}
+
+void DocumentManagerPrivate::cacheDocument()
+{
+    if (document->isNew() || (nullptr != pager) || !diskHashValid) {
+        return;
+    }
+
+    if (writer->writeInProgress()) {
+        writer->waitForFinished();
+    }
+
+    DocumentCache::Document cachedDocument;
+    cachedDocument.text = document->toPlainText();
+
+    // Unsaved changes may just have been discarded.
+    if (ContentHash::hash(cachedDocument.text) != diskHash) {
+        return;
+    }
+
+    cachedDocument.ast = document->takeMarkdownAST();
+    cachedDocument.blockStatistics.reserve(document->blockCount());
+
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next()) {
+        TextBlockData *blockData = (TextBlockData *) block.userData();
+
+        if (nullptr == blockData) {
+            cachedDocument.blockStatistics.clear();
+            break;
+        }
+
+        DocumentCache::BlockStatistics statistics;
+        statistics.wordCount = blockData->wordCount;
+        statistics.alphaNumericCharacterCount = blockData->alphaNumericCharacterCount;
+        statistics.sentenceCount = blockData->sentenceCount;
+        statistics.lixLongWordCount = blockData->lixLongWordCount;
+        cachedDocument.blockStatistics.append(statistics);
+    }
+
+    if (nullptr != spelling) {
+        cachedDocument.spelling = spelling->results();
+    }
+
+    cache.insert(document->filePath(), cachedDocument);
+}
+
+void DocumentManagerPrivate::closePager()
+{
+    if (nullptr != pager) {
+        delete pager;
+        pager = nullptr;
+    }
+}
+
+int DocumentManagerPrivate::cursorPosition() const
+{
+    if (nullptr != pager) {
+        return pager->cursorPosition();
+    }
+
+    return editor->textCursor().position();
+}
+
+void DocumentManagerPrivate::navigateDocument(int position)
+{
+    if (nullptr != pager) {
+        pager->navigateDocument(position);
+    } else {
+        editor->navigateDocument(position);
+    }
+}
+
+int DocumentManagerPrivate::chunkLength(const QString &text,
+    int position,
+    int maxLength)
+{
+    int end = position + maxLength;
+
+    if (end >= text.length()) {
+        return int(text.length()) - position;
+    }
+
+    for (int i = end - 1; i >= position; i--) {
+        if ('\n' == text.at(i)) {
+            return i + 1 - position;
+        }
+    }
+
+    // Without a line break, at least keep surrogate pairs and CRLFs whole.
+    if ((text.at(end - 1).isHighSurrogate() || ('\r' == text.at(end - 1)))
+            && ((end - 1) > position)) {
+        end--;
+    }
+
+    return end - position;
+}
+
 void DocumentManagerPrivate::setFilePath(const QString &filePath)
 {
     Q_Q(DocumentManager);
@@ -819,6 +1463,11 @@ void DocumentManagerPrivate::setFilePath(const QString &filePath)
         fileWatcher->removePath(document->filePath());
     }
 
+    // The journal is restarted for the new path by the next load or save.
+    journal->stop();
+    journalBaseText = QString();
+    diskHashValid = false;
+
     document->setFilePath(filePath);
     writer->setFileName(filePath);
 
@@ -927,33 +1576,6 @@ bool DocumentManagerPrivate::checkPermissionsBeforeSave()
     return true;
 }
 
-void DocumentManagerPrivate::backupFile(const QString &filePath) const
-{
-    QString backupFilePath = filePath + ".backup";
-    QFile backupFile(backupFilePath);
-
-    if (backupFile.exists()) {
-        if (!backupFile.remove()) {
-            MessageBoxHelper::critical(
-                this->editor,
-                QObject::tr("File backup failed"),
-                backupFile.errorString()
-            );
-            return;
-        }
-    }
-
-    QFile file(filePath);
-
-    if (!file.copy(backupFilePath)) {
-        MessageBoxHelper::critical(
-            this->editor,
-            QObject::tr("File backup failed"),
-            backupFile.errorString()
-        );
-    }
-}
-
 void DocumentManagerPrivate::autoSaveFile()
 {
     Q_Q(DocumentManager);
@@ -961,11 +1583,33 @@ void DocumentManagerPrivate::autoSaveFile()
     if
     (
         this->autoSaveEnabled &&
+        !this->loadInProgress &&
         !this->document->isNew() &&
         !this->document->isReadOnly() &&
         this->document->isModified()
     ) {
+        // With the journal holding every edit, rewriting the whole
+        // document can wait until the journal has grown large in
+        // proportion to it.
+        if (this->journal->isActive()
+                && (this->journal->size() < qMax<qint64>(
+                    GW_JOURNAL_MIN_COMPACT_SIZE,
+                    this->document->characterCount() / 2))) {
+            this->journal->sync();
+            return;
+        }
+
+        // Autosaves are repeated every minute, so they can skip flushing
+        // to disk and spare slow disks the extra wait.
+        this->writer->setDurability(AsyncTextWriter::NoSync);
         q->save();
+        this->writer->setDurability(AsyncTextWriter::SyncAll);
+    } else if (this->journal->isActive()
+            && (this->journal->size() > qMax<qint64>(
+                GW_JOURNAL_MIN_COMPACT_SIZE,
+                qint64(this->document->characterCount()) * 2))) {
+        // Without autosave, keep the journal from outgrowing the document.
+        this->journal->compact();
     }
 }
 
@@ -998,4 +1642,42 @@ void DocumentManagerPrivate::createDraft()
     }
 }
 
+void DocumentManagerPrivate::startJournal(bool recover)
+{
+    if (!journalEnabled || document->isNew() || document->isReadOnly()
+            || (nullptr != pager)) {
+        return;
+    }
+
+    QString text = document->toPlainText();
+    QString recoveredText;
+
+    if (recover && EditJournal::recover(document->filePath(), draftLocation,
+            text, recoveredText)) {
+        int response =
+            MessageBoxHelper::question
+            (
+                editor,
+                QObject::tr("Unsaved changes to %1 were found.")
+                    .arg(document->displayName()),
+                QObject::tr("Would you like to recover them?"),
+                QMessageBox::Yes | QMessageBox::No,
+                QMessageBox::Yes
+            );
+
+        if (QMessageBox::Yes == response) {
+            int position = editor->textCursor().position();
+
+            // Replace the text as a single edit that can be undone.
+            QTextCursor cursor(document);
+            cursor.select(QTextCursor::Document);
+            cursor.insertText(recoveredText);
+
+            editor->navigateDocument(qMin(position, int(recoveredText.length())));
+        }
+    }
+
+    journal->start(document->filePath(), draftLocation, text);
+}
+
 }
@@ -25,6 +25,7 @@
 
 #include "markdowndocument.h"
 #include "markdowneditor.h"
+#include "spelling/spellcheckdecorator.h"
 
 namespace ghostwriter
 {
@@ -72,11 +73,43 @@ public:
      */
     bool fileBackupEnabled() const;
 
+    /**
+     * Gets the number of backup files kept for the document.
+     */
+    int fileBackupCount() const;
+
+    /**
+     * Gets whether unsaved edits are journaled to disk, so that they can
+     * be recovered when the document is next opened after a crash.
+     */
+    bool editJournalEnabled() const;
+
     /**
      * Gets whether tracking the recent file history is enabled.
      */
     void setFileHistoryEnabled(bool enabled);
 
+    /**
+     * Sets the spell checker of the editor, whose results are kept along
+     * with recently closed documents.
+     */
+    void setSpellCheckDecorator(SpellCheckDecorator *decorator);
+
+    /**
+     * Returns the block of the document holding the given line of the
+     * file, counting from zero, or an invalid block if there is no such
+     * line.  Files too large to be loaded as a whole are only ever held
+     * in the document in part, so the part around the line is loaded
+     * first.
+     */
+    QTextBlock blockForLine(int line);
+
+    /**
+     * Returns true if the file is too large to be loaded as a whole, in
+     * which case the document holds only the part of it being viewed.
+     */
+    bool isPaged() const;
+
 signals:
     /**
      * Emitted when the document's display name changes, which is useful
@@ -149,6 +182,21 @@ public slots:
      */
     void setFileBackupEnabled(bool enabled);
 
+    /**
+     * Sets the number of timestamped backup files kept for the document
+     * when file backup is enabled.  The oldest backups beyond this number
+     * are removed after each new backup.
+     */
+    void setFileBackupCount(int count);
+
+    /**
+     * Sets whether unsaved edits are journaled to a hidden file next to
+     * the document (or in the draft location if the document's directory
+     * is not writable).  When enabled, auto-save only rewrites the whole
+     * document once the journal has grown large.
+     */
+    void setEditJournalEnabled(bool enabled);
+
     /**
      * Sets draft directory location where draft files (i.e., autosaved
      * untitled documents) will be saved.
@@ -173,6 +221,8 @@ public slots:
      * Note that if the document is modified, this method will discard
      * changes before reloading.  It is left to the caller to check for
      * modification and save any changes before calling this method.
+     * Only the lines that differ from the file are replaced, as a single
+     * step that can be undone.
      */
     void reload();
 
@@ -64,7 +64,15 @@ public:
     int readTimeMinutes;
 
     void updateStatistics();
-    void updateBlockStatistics(QTextBlock &block);
+
+    /*
+    * Counts the statistics of every block again and updates the totals.
+    * If keepBlockStatistics is true, blocks that already have statistics,
+    * such as those restored along with the text of a file, are not
+    * counted again.
+    */
+    void recountStatistics(bool keepBlockStatistics);
+    void updateBlockStatistics(QTextBlock &block, bool keepBlockStatistics = false);
     void countWords
     (
         const QString &text,
@@ -108,6 +116,11 @@ DocumentStatistics::DocumentStatistics(MarkdownDocument *document, QObject *pare
             d->readTimeMinutes = 0;
             d->updateStatistics();
         });
+    connect(d->document,
+        &MarkdownDocument::loadingFinished,
+        [d]() {
+            d->recountStatistics(true);
+        });
 }
 
 DocumentStatistics::~DocumentStatistics()
@@ -222,28 +235,38 @@ void DocumentStatistics::onTextChanged(int position, int charsRemoved, int chars
     Q_UNUSED(charsRemoved)
     Q_UNUSED(charsAdded)
 
-    d->wordCount = 0;
-    d->wordCharacterCount = 0;
-    d->sentenceCount = 0;
-    d->paragraphCount = 0;
-    d->pageCount = 0;
-    d->lixLongWordCount = 0;
-    d->readTimeMinutes = 0;
+    // The whole document is counted once it has finished loading.
+    if (d->document->isLoading()) {
+        return;
+    }
+
+    d->recountStatistics(false);
+}
+
+void DocumentStatisticsPrivate::recountStatistics(bool keepBlockStatistics)
+{
+    this->wordCount = 0;
+    this->wordCharacterCount = 0;
+    this->sentenceCount = 0;
+    this->paragraphCount = 0;
+    this->pageCount = 0;
+    this->lixLongWordCount = 0;
+    this->readTimeMinutes = 0;
 
     // Update the word counts of affected blocks.
     //
-    QTextBlock startBlock = d->document->firstBlock();
-    QTextBlock endBlock = d->document->lastBlock();
+    QTextBlock startBlock = document->firstBlock();
+    QTextBlock endBlock = document->lastBlock();
     QTextBlock block = startBlock;
 
-    d->updateBlockStatistics(block);
+    updateBlockStatistics(block, keepBlockStatistics);
 
     while (block != endBlock) {
         block = block.next();
-        d->updateBlockStatistics(block);
+        updateBlockStatistics(block, keepBlockStatistics);
     }
 
-    d->updateStatistics();
+    updateStatistics();
 }
 
 void DocumentStatisticsPrivate::updateStatistics()
@@ -265,28 +288,35 @@ void DocumentStatisticsPrivate::updateStatistics()
     emit q->readabilityIndexChanged(calculateCLI(wordCharacterCount, wordCount, sentenceCount));
 }
 
-void DocumentStatisticsPrivate::updateBlockStatistics(QTextBlock &block)
+void DocumentStatisticsPrivate::updateBlockStatistics
+(
+    QTextBlock &block,
+    bool keepBlockStatistics
+)
 {
     TextBlockData *blockData = (TextBlockData *) block.userData();
 
     if (nullptr == blockData) {
         blockData = new TextBlockData(document, block);
         block.setUserData(blockData);
+        keepBlockStatistics = false;
     }
 
-    countWords
-    (
-        block.text(),
-        blockData->wordCount,
-        blockData->lixLongWordCount,
-        blockData->alphaNumericCharacterCount
-    );
+    if (!keepBlockStatistics) {
+        countWords
+        (
+            block.text(),
+            blockData->wordCount,
+            blockData->lixLongWordCount,
+            blockData->alphaNumericCharacterCount
+        );
+
+        blockData->sentenceCount = countSentences(block.text());
+    }
 
     wordCount += blockData->wordCount;
     lixLongWordCount += blockData->lixLongWordCount;
     wordCharacterCount += blockData->alphaNumericCharacterCount;
-
-    blockData->sentenceCount = countSentences(block.text());
     sentenceCount += blockData->sentenceCount;
 
     if (block.text().trimmed().length() > 0) {
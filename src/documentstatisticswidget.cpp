@@ -62,6 +62,9 @@ public:
 
     // Coleman-Liau readability index (CLI)
     QLabel *cliLabel;
+
+    // Shown while only part of the document is counted
+    QListWidgetItem *partialItem;
 };
 
 DocumentStatisticsWidget::DocumentStatisticsWidget(QWidget *parent)
@@ -80,6 +83,12 @@ DocumentStatisticsWidget::DocumentStatisticsWidget(QWidget *parent)
     d->lixReadingEaseLabel = addStatisticLabel(tr("Reading Ease:"), d->VERY_EASY_READING_EASE_STR, tr("LIX Reading Ease"));
     d->cliLabel = addStatisticLabel(tr("Grade Level:"), "0", tr("Coleman-Liau Readability Index (CLI)"));
 
+    d->partialItem = new QListWidgetItem(tr("Part of the file shown only"));
+    d->partialItem->setTextAlignment(Qt::AlignCenter);
+    d->partialItem->setToolTip(tr("The file is too large to be loaded as a whole, so only the part of it being viewed is counted."));
+    this->insertItem(0, d->partialItem);
+    d->partialItem->setHidden(true);
+
 }
 
 DocumentStatisticsWidget::~DocumentStatisticsWidget()
@@ -171,4 +180,11 @@ void DocumentStatisticsWidget::setReadabilityIndex(int value)
 
     setStringValueForLabel(d->cliLabel, cliStr);
 }
+
+void DocumentStatisticsWidget::setPartial(bool partial)
+{
+    Q_D(DocumentStatisticsWidget);
+
+    d->partialItem->setHidden(!partial);
+}
 } // namespace ghostwriter
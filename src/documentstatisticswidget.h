@@ -92,6 +92,12 @@ public slots:
      */
     void setReadabilityIndex(int value);
 
+    /**
+     * Sets whether the statistics are for only part of the document, in
+     * which case this is noted above them.
+     */
+    void setPartial(bool partial);
+
 private:
     QScopedPointer<DocumentStatisticsWidgetPrivate> d_ptr;
 };
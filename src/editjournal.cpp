@@ -0,0 +1,578 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTextCursor>
+#include <QTextDocumentFragment>
+#include <QTimer>
+#include <QtEndian>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "contenthash.h"
+#include "editjournal.h"
+
+#define GW_EDIT_JOURNAL_SUFFIX ".gwjournal"
+#define GW_EDIT_JOURNAL_MAGIC 0x4e524a47 // "GJRN"
+#define GW_EDIT_JOURNAL_RECORD_MAGIC 0x31434552 // "REC1"
+#define GW_EDIT_JOURNAL_VERSION 1
+
+// Records are flushed to disk this many milliseconds after the first
+// unflushed one was appended, rather than after every keystroke.
+#define GW_EDIT_JOURNAL_SYNC_INTERVAL 1000
+
+namespace ghostwriter
+{
+class EditJournalPrivate
+{
+    Q_DECLARE_PUBLIC(EditJournal)
+
+public:
+    EditJournalPrivate(EditJournal *q_ptr)
+        : q_ptr(q_ptr),
+          document(nullptr),
+          syncTimer(nullptr),
+          baseLength(0),
+          baseHash(0),
+          sequence(1),
+          revision(0)
+    {
+        ;
+    }
+
+    ~EditJournalPrivate()
+    {
+        ;
+    }
+
+    EditJournal *q_ptr;
+    QTextDocument *document;
+    QTimer *syncTimer;
+
+    // Journal file, which is only open while journaling.
+    QFile file;
+
+    qint64 baseLength;
+    quint64 baseHash;
+    quint64 sequence;
+    int revision;
+
+    /*
+    * Returns the possible journal file paths for the given file, the
+    * first being next to the file and the second in the fallback
+    * directory.
+    */
+    static QStringList journalPaths
+    (
+        const QString &filePath,
+        const QString &fallbackDirectory
+    );
+
+    static QByteArray header(qint64 baseLength, quint64 baseHash);
+
+    static QByteArray record
+    (
+        quint64 sequence,
+        int position,
+        int charsRemoved,
+        const QString &added,
+        qint64 lengthAfter
+    );
+
+    /*
+    * Replays the given journal contents onto the base text.  Returns
+    * true if at least one record could be applied, stopping at the first
+    * record that is torn, out of sequence or does not apply.
+    */
+    static bool replay
+    (
+        const QByteArray &data,
+        const QString &baseText,
+        QString &text
+    );
+
+    /*
+    * Atomically replaces the journal with the header, followed by a
+    * single record replacing the base text with the given text if they
+    * differ, and reopens it for appending.
+    */
+    bool rewrite(const QString &text);
+
+    void append(int position, int charsRemoved, const QString &added);
+
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+    /*
+    * Stops journaling after a failed write, leaving whatever made it to
+    * disk for recovery.
+    */
+    void fail(const QString &error);
+};
+
+template <typename T>
+static void put(QByteArray &data, T value)
+{
+    T littleEndian = qToLittleEndian(value);
+    data.append(reinterpret_cast<const char *>(&littleEndian), sizeof(T));
+}
+
+template <typename T>
+static bool take(const QByteArray &data, int &offset, T &value)
+{
+    if ((int(data.size()) - offset) < int(sizeof(T))) {
+        return false;
+    }
+
+    value = qFromLittleEndian<T>(data.constData() + offset);
+    offset += sizeof(T);
+    return true;
+}
+
+EditJournal::EditJournal(QTextDocument *document, QObject *parent)
+    : QObject(parent),
+      d_ptr(new EditJournalPrivate(this))
+{
+    Q_D(EditJournal);
+
+    d->document = document;
+    d->syncTimer = new QTimer(this);
+    d->syncTimer->setSingleShot(true);
+    d->syncTimer->setInterval(GW_EDIT_JOURNAL_SYNC_INTERVAL);
+
+    this->connect(d->syncTimer,
+        &QTimer::timeout,
+        [this]() {
+            sync();
+        });
+
+    this->connect(document,
+        &QTextDocument::contentsChange,
+        this,
+        [d](int position, int charsRemoved, int charsAdded) {
+            d->onContentsChange(position, charsRemoved, charsAdded);
+        });
+}
+
+EditJournal::~EditJournal()
+{
+    sync();
+}
+
+bool EditJournal::start
+(
+    const QString &filePath,
+    const QString &fallbackDirectory,
+    const QString &baseText
+)
+{
+    Q_D(EditJournal);
+
+    stop(true);
+
+    QStringList paths =
+        EditJournalPrivate::journalPaths(filePath, fallbackDirectory);
+    QString path = paths.first();
+
+    if ((paths.size() > 1)
+            && !QFileInfo(QFileInfo(filePath).absolutePath()).isWritable()) {
+        path = paths.last();
+    }
+
+    // Never leave a stale journal behind for recover() to find.
+    for (const QString &stalePath : paths) {
+        if ((stalePath != path) && QFile::exists(stalePath)) {
+            QFile::remove(stalePath);
+        }
+    }
+
+    d->file.setFileName(path);
+    d->baseLength = baseText.length();
+    d->baseHash = ContentHash::hash(baseText);
+    d->revision = d->document->revision();
+
+    return d->rewrite(d->document->toPlainText());
+}
+
+void EditJournal::stop(bool keep)
+{
+    Q_D(EditJournal);
+
+    d->syncTimer->stop();
+
+    if (d->file.isOpen()) {
+        if (keep) {
+            sync();
+        }
+
+        d->file.close();
+    }
+
+    if (!keep && !d->file.fileName().isEmpty()) {
+        QFile::remove(d->file.fileName());
+    }
+
+    d->file.setFileName(QString());
+}
+
+bool EditJournal::isActive() const
+{
+    Q_D(const EditJournal);
+
+    return d->file.isOpen();
+}
+
+qint64 EditJournal::size() const
+{
+    Q_D(const EditJournal);
+
+    if (d->file.isOpen()) {
+        return d->file.size();
+    }
+
+    return 0;
+}
+
+bool EditJournal::compact()
+{
+    Q_D(EditJournal);
+
+    if (!d->file.isOpen()) {
+        return false;
+    }
+
+    return d->rewrite(d->document->toPlainText());
+}
+
+void EditJournal::sync()
+{
+    Q_D(EditJournal);
+
+    d->syncTimer->stop();
+
+#ifdef Q_OS_UNIX
+    if (d->file.isOpen()) {
+        ::fsync(d->file.handle());
+    }
+#endif
+}
+
+bool EditJournal::recover
+(
+    const QString &filePath,
+    const QString &fallbackDirectory,
+    const QString &baseText,
+    QString &text
+)
+{
+    QStringList paths =
+        EditJournalPrivate::journalPaths(filePath, fallbackDirectory);
+
+    for (const QString &path : paths) {
+        QFile file(path);
+
+        if (file.open(QIODevice::ReadOnly)
+                && EditJournalPrivate::replay(file.readAll(), baseText, text)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+QStringList EditJournalPrivate::journalPaths
+(
+    const QString &filePath,
+    const QString &fallbackDirectory
+)
+{
+    QFileInfo info(filePath);
+    QStringList paths;
+
+    paths << info.absolutePath() + "/." + info.fileName()
+        + GW_EDIT_JOURNAL_SUFFIX;
+
+    if (!fallbackDirectory.isEmpty()) {
+        // Tell apart files of the same name from different directories.
+        QByteArray path = info.absoluteFilePath().toUtf8();
+
+        paths << fallbackDirectory + "/." + info.fileName() + "-"
+            + QString::number(ContentHash::hash(path), 16)
+            + GW_EDIT_JOURNAL_SUFFIX;
+    }
+
+    return paths;
+}
+
+QByteArray EditJournalPrivate::header(qint64 baseLength, quint64 baseHash)
+{
+    QByteArray data;
+
+    put<quint32>(data, GW_EDIT_JOURNAL_MAGIC);
+    put<quint32>(data, GW_EDIT_JOURNAL_VERSION);
+    put<qint64>(data, baseLength);
+    put<quint64>(data, baseHash);
+    put<quint64>(data, ContentHash::hash(data.constData(), data.size()));
+
+    return data;
+}
+
+QByteArray EditJournalPrivate::record
+(
+    quint64 sequence,
+    int position,
+    int charsRemoved,
+    const QString &added,
+    qint64 lengthAfter
+)
+{
+    QByteArray data;
+
+    put<quint32>(data, GW_EDIT_JOURNAL_RECORD_MAGIC);
+    put<quint64>(data, sequence);
+    put<qint32>(data, position);
+    put<qint32>(data, charsRemoved);
+    put<qint64>(data, lengthAfter);
+    put<qint32>(data, added.size());
+
+    int offset = int(data.size());
+    data.resize(offset + (int(added.size()) * int(sizeof(quint16))));
+
+    const ushort *units = added.utf16();
+    char *dest = data.data() + offset;
+
+    for (int i = 0; i < added.size(); i++) {
+        qToLittleEndian<quint16>(units[i], dest + (i * int(sizeof(quint16))));
+    }
+
+    put<quint64>(data, ContentHash::hash(data.constData(), data.size()));
+
+    return data;
+}
+
+bool EditJournalPrivate::replay
+(
+    const QByteArray &data,
+    const QString &baseText,
+    QString &text
+)
+{
+    int offset = 0;
+    quint32 magic;
+    quint32 version;
+    qint64 baseLength;
+    quint64 baseHash;
+    quint64 headerChecksum;
+
+    if (!take(data, offset, magic)
+            || !take(data, offset, version)
+            || !take(data, offset, baseLength)
+            || !take(data, offset, baseHash)) {
+        return false;
+    }
+
+    int headerLength = offset;
+
+    if (!take(data, offset, headerChecksum)
+            || (GW_EDIT_JOURNAL_MAGIC != magic)
+            || (GW_EDIT_JOURNAL_VERSION != version)
+            || (ContentHash::hash(data.constData(), headerLength) != headerChecksum)) {
+        return false;
+    }
+
+    // The journal is of no use if the file changed since it was started.
+    if ((baseText.length() != baseLength) || (ContentHash::hash(baseText) != baseHash)) {
+        return false;
+    }
+
+    QString result = baseText;
+    quint64 expectedSequence = 1;
+
+    forever {
+        int start = offset;
+        quint32 recordMagic;
+        quint64 sequence;
+        qint32 position;
+        qint32 charsRemoved;
+        qint64 lengthAfter;
+        qint32 addedLength;
+
+        if (!take(data, offset, recordMagic)
+                || !take(data, offset, sequence)
+                || !take(data, offset, position)
+                || !take(data, offset, charsRemoved)
+                || !take(data, offset, lengthAfter)
+                || !take(data, offset, addedLength)) {
+            break;
+        }
+
+        if ((GW_EDIT_JOURNAL_RECORD_MAGIC != recordMagic)
+                || (expectedSequence != sequence)
+                || (addedLength < 0)
+                || ((qint64(data.size()) - offset)
+                    < (qint64(addedLength) * qint64(sizeof(quint16))))) {
+            break;
+        }
+
+        const char *added = data.constData() + offset;
+        offset += addedLength * int(sizeof(quint16));
+
+        int recordLength = offset - start;
+        quint64 recordChecksum;
+
+        if (!take(data, offset, recordChecksum)
+                || (ContentHash::hash(data.constData() + start, recordLength) != recordChecksum)) {
+            break;
+        }
+
+        if ((position < 0) || (position > result.length())) {
+            break;
+        }
+
+        charsRemoved = qBound(0, charsRemoved, int(result.length()) - position);
+
+        if ((result.length() - charsRemoved + addedLength) != lengthAfter) {
+            break;
+        }
+
+        QString addedText(addedLength, Qt::Uninitialized);
+        QChar *units = addedText.data();
+
+        for (int i = 0; i < addedLength; i++) {
+            units[i] = QChar(qFromLittleEndian<quint16>(added + (i * int(sizeof(quint16)))));
+        }
+        result.replace(position, charsRemoved, addedText);
+        expectedSequence++;
+    }
+
+    if ((expectedSequence > 1) && (result != baseText)) {
+        text = result;
+        return true;
+    }
+
+    return false;
+}
+
+bool EditJournalPrivate::rewrite(const QString &text)
+{
+    QString path = file.fileName();
+
+    syncTimer->stop();
+    file.close();
+
+    QByteArray data = header(baseLength, baseHash);
+    sequence = 1;
+
+    if ((text.length() != baseLength) || (ContentHash::hash(text) != baseHash)) {
+        data += record(sequence++, 0, int(baseLength), text, text.length());
+    }
+
+    QSaveFile saveFile(path);
+
+    if (!saveFile.open(QIODevice::WriteOnly)
+            || (saveFile.write(data) != data.size())
+            || !saveFile.commit()) {
+        fail(saveFile.errorString());
+        return false;
+    }
+
+    file.setFileName(path);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        fail(file.errorString());
+        return false;
+    }
+
+    return true;
+}
+
+void EditJournalPrivate::append
+(
+    int position,
+    int charsRemoved,
+    const QString &added
+)
+{
+    QByteArray data = record(sequence, position, charsRemoved, added,
+        document->characterCount() - 1);
+
+    if (file.write(data) != data.size()) {
+        fail(file.errorString());
+        return;
+    }
+
+    sequence++;
+
+    if (!syncTimer->isActive()) {
+        syncTimer->start();
+    }
+}
+
+void EditJournalPrivate::onContentsChange
+(
+    int position,
+    int charsRemoved,
+    int charsAdded
+)
+{
+    if (!file.isOpen()) {
+        return;
+    }
+
+    // Highlighting and spell checking report format changes as if the
+    // text had been replaced by itself, without a new revision.
+    if ((charsRemoved == charsAdded) && (document->revision() == revision)) {
+        return;
+    }
+
+    revision = document->revision();
+
+    // Changes at the end of the document may count the final paragraph
+    // separator, which is not part of the plain text.
+    int length = document->characterCount() - 1;
+
+    position = qBound(0, position, length);
+    charsAdded = qBound(0, charsAdded, length - position);
+
+    QString added;
+
+    if (charsAdded > 0) {
+        QTextCursor cursor(document);
+        cursor.setPosition(position);
+        cursor.setPosition(position + charsAdded, QTextCursor::KeepAnchor);
+        added = cursor.selection().toPlainText();
+    }
+
+    append(position, charsRemoved, added);
+}
+
+void EditJournalPrivate::fail(const QString &error)
+{
+    qWarning() << "Edit journal" << file.fileName() << "stopped:" << error;
+
+    syncTimer->stop();
+    file.close();
+    file.setFileName(QString());
+}
+} // namespace ghostwriter
@@ -0,0 +1,124 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef EDIT_JOURNAL_H
+#define EDIT_JOURNAL_H
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QString>
+#include <QTextDocument>
+
+namespace ghostwriter
+{
+/**
+ * Append-only journal of the unsaved edits made to a document, kept in a
+ * hidden file next to the document so that the edits can be recovered
+ * after a crash.
+ *
+ * The journal begins with a header identifying the text it applies to
+ * (normally the file contents last loaded or saved), followed by one
+ * record per change to the document.  Each record carries a sequence
+ * number and a checksum, so that a record torn by a crash in the middle
+ * of writing it is detected and the replay stops just before it.
+ *
+ * Records are appended as the document changes and flushed to disk
+ * shortly afterwards.  The journal is only rewritten as a whole when it
+ * is started against new text, such as after the document is saved, or
+ * when it is compacted.
+ */
+class EditJournalPrivate;
+class EditJournal : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(EditJournal)
+
+public:
+    /**
+     * Constructor.  The journal records nothing until start() is called.
+     */
+    EditJournal(QTextDocument *document, QObject *parent = nullptr);
+
+    /**
+     * Destructor.  Leaves the journal file on disk.
+     */
+    virtual ~EditJournal();
+
+    /**
+     * Starts journaling the edits made to the document at the given file
+     * path, replacing any existing journal for it.  The base text is the
+     * text the journal applies to, which must be the file contents on
+     * disk.  If the document differs from the base text, the difference
+     * is recorded straight away.  The journal is kept next to the file,
+     * or in the fallback directory if the file's directory is not
+     * writable.  Returns false if the journal could not be written.
+     */
+    bool start
+    (
+        const QString &filePath,
+        const QString &fallbackDirectory,
+        const QString &baseText
+    );
+
+    /**
+     * Stops journaling.  The journal file is removed unless keep is true.
+     */
+    void stop(bool keep = false);
+
+    /**
+     * Returns true if edits to the document are being journaled.
+     */
+    bool isActive() const;
+
+    /**
+     * Returns the size of the journal file in bytes.
+     */
+    qint64 size() const;
+
+    /**
+     * Rewrites the journal as a single record holding the whole document,
+     * against the same base text.
+     */
+    bool compact();
+
+    /**
+     * Flushes the records appended so far to disk.
+     */
+    void sync();
+
+    /**
+     * Replays the journal left for the file at the given path onto the
+     * base text, which must be the current file contents.  Returns true
+     * and sets text to the recovered text if the journal applies to the
+     * base text and holds at least one edit.
+     */
+    static bool recover
+    (
+        const QString &filePath,
+        const QString &fallbackDirectory,
+        const QString &baseText,
+        QString &text
+    );
+
+private:
+    QScopedPointer<EditJournalPrivate> d_ptr;
+};
+} // namespace ghostwriter
+
+#endif // EDIT_JOURNAL_H
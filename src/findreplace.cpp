@@ -17,20 +17,32 @@
  *
  ***********************************************************************/
 
+#include <algorithm>
+#include <atomic>
+
 #include <QApplication>
+#include <QFutureWatcher>
 #include <QGridLayout>
 #include <QLabel>
 #include <QLineEdit>
 #include <QMenu>
 #include <QPushButton>
 #include <QRegularExpression>
+#include <QScrollBar>
 #include <QSettings>
+#include <QSharedPointer>
+#include <QPair>
 #include <QStringList>
+#include <QStringMatcher>
+#include <QTextBlock>
 #include <QTextEdit>
 #include <QTextCursor>
 #include <QTimer>
+#include <QVector>
+#include <QtConcurrentRun>
 
 #include "findreplace.h"
+#include "trigramindex.h"
 #include "3rdparty/QtAwesome/QtAwesome.h"
 
 #define GW_FIND_REPLACE_MATCH_CASE "FindReplace/matchCase"
@@ -38,6 +50,21 @@
 #define GW_FIND_REPLACE_REGEX "FindReplace/regularExpression"
 #define GW_FIND_REPLACE_HIGHLIGHT_MATCHES "FindReplace/highlightMatches"
 
+// Delay after the last change to the query before matches are highlighted.
+#define GW_FIND_REPLACE_HIGHLIGHT_DELAY 150
+
+// Number of blocks above and below the viewport in which matches are
+// highlighted, so that small scrolls do not reveal unhighlighted matches.
+#define GW_FIND_REPLACE_HIGHLIGHT_MARGIN 50
+
+// Minimum document length, in characters, for which literal searches are
+// narrowed down with a trigram index.
+#define GW_FIND_REPLACE_INDEX_MIN_LENGTH (1024 * 1024)
+
+// Maximum number of candidate blocks from the trigram index for which
+// matches are highlighted right away rather than on a worker thread.
+#define GW_FIND_REPLACE_INDEX_MAX_CANDIDATES 2048
+
 namespace ghostwriter
 {
 class FindReplacePrivate
@@ -45,8 +72,34 @@ class FindReplacePrivate
     Q_DECLARE_PUBLIC(FindReplace)
 
 public:
+    typedef QVector<QPair<int, int>> MatchList;
+
+    /*
+    * Compiled form of the query in the find field.  Literal queries are
+    * searched for with a QStringMatcher, which skips ahead through the
+    * text instead of comparing at every position, and regular expressions
+    * are optimized as soon as the query is compiled.
+    */
+    struct SearchQuery
+    {
+        QString text;
+        bool regularExpression = false;
+        bool wholeWords = false;
+        Qt::CaseSensitivity caseSensitivity = Qt::CaseInsensitive;
+        QRegularExpression expr;
+        QStringMatcher matcher;
+
+        bool isValid() const
+        {
+            return !text.isEmpty() && (!regularExpression || expr.isValid());
+        }
+    };
+
     FindReplacePrivate(FindReplace *q_ptr)
-        : q_ptr(q_ptr)
+        : q_ptr(q_ptr),
+          scanWatcher(nullptr),
+          index(nullptr),
+          documentTextValid(false)
     {
         this->awesome = new QtAwesome(q_ptr);
         this->awesome->initFontAwesome();
@@ -58,7 +111,100 @@ public:
     }
 
     bool findMatch(QTextCursor& cursor, bool wrap = true, bool backwards = false);
+
+    /*
+    * Returns the compiled query for the find field.  The last query is
+    * reused as long as neither its text nor its options have changed, so
+    * that the pattern is not compiled again for every match.
+    */
+    const SearchQuery &searchQuery() const;
+
+    /*
+    * Returns a plain text snapshot of the document, in which positions
+    * are the same as in the document and blocks are separated by line
+    * breaks.  The snapshot is reused until the document changes.
+    */
+    const QString &documentText() const;
+
+    /*
+    * Finds the blocks that may contain a match for the query, in document
+    * order.  Returns false if the trigram index cannot narrow the search,
+    * in which case the whole document has to be searched.  Starts
+    * building the index for large documents.
+    */
+    bool candidateBlocks(const SearchQuery &query, QVector<int> &blockNumbers) const;
+
+    /*
+    * Finds every match of the query in the given blocks.
+    */
+    MatchList findMatchesInBlocks(const SearchQuery &query, const QVector<int> &blockNumbers) const;
+
+    /*
+    * Finds the next literal match of the query from the given cursor in
+    * the document text, or the previous one if searching backwards.
+    * Returns a null cursor if there is no match.
+    */
+    QTextCursor findLiteral(const SearchQuery &query, const QTextCursor &cursor, bool backwards) const;
+
+    /*
+    * Returns the position of the first literal match of the query in the
+    * text at or after from, or of the last one at or before from if
+    * searching backwards, or -1 if there is none.
+    */
+    static int findLiteralInText(const QString &text, int from, const SearchQuery &query, bool backwards);
+
+    /*
+    * Returns true if the match at the given position of the text is not
+    * part of a longer word.
+    */
+    static bool isWholeWord(const QString &text, int start, int length);
+
+    /*
+    * Appends the start position and length of every match of the given
+    * expression in the given block text to matches, offset by the
+    * position of the block.  As with QTextDocument::find(), matches do
+    * not span blocks.
+    */
+    static void findMatchesInBlock
+    (
+        const QString &text,
+        int blockPosition,
+        const QRegularExpression &expr,
+        bool wholeWords,
+        QVector<QPair<int, int>> &matches
+    );
+
+    /*
+    * Finds every match in the given snapshot of the document text, whose
+    * blocks are separated by line breaks.  Safe to run on a worker thread,
+    * in which case it gives up early once canceled is set.
+    */
+    static MatchList findMatches
+    (
+        const QString &text,
+        const SearchQuery &query,
+        QSharedPointer<std::atomic<bool>> canceled = QSharedPointer<std::atomic<bool>>()
+    );
+
+    /*
+    * Starts scanning the document for matches in the background if
+    * enabled, canceling any scan still running.  Otherwise, clears the
+    * highlighted matches.
+    */
     void highlightMatches(bool enabled);
+
+    /*
+    * Installs extra selections for the matches in or near the viewport.
+    */
+    void highlightVisibleMatches();
+
+    void onScanFinished();
+
+    /*
+    * Replaces the matches to highlight, and updates the status label.
+    */
+    void setMatches(const MatchList &matches);
+    void cancelScan();
     void setQueryFromSelection();
     void setReplaceRowVisible(bool visible);
     void startHighlightTimer();
@@ -75,6 +221,7 @@ public:
     QPushButton *highlightMatchesButton;
     QPushButton *findNextButton;
     QPushButton *findPrevButton;
+    QPushButton *findInFolderButton;
     QPushButton *replaceButton;
     QPushButton *replaceAllButton;
 
@@ -85,6 +232,18 @@ public:
     bool replaceRowVisible;
     QTimer *highlightTimer;
 
+    // Matches from the last completed scan, in document order.  Only the
+    // ones near the viewport are highlighted, since installing an extra
+    // selection for each of tens of thousands of matches is slow.
+    MatchList matches;
+    QFutureWatcher<MatchList> *scanWatcher;
+    QSharedPointer<std::atomic<bool>> scanCanceled;
+    TrigramIndex *index;
+
+    mutable SearchQuery query;
+    mutable QString documentTextCache;
+    mutable bool documentTextValid;
+
     QStringList searchHistory;
     int searchHistoryIndex;
 
@@ -154,6 +313,11 @@ FindReplace::FindReplace(QPlainTextEdit *editor, QWidget *parent)
     d->findNextButton->setFont(d->awesome->font(style::stfas, buttonFont.pointSize()));
     d->findNextButton->setToolTip(tr("Find next"));
     connect(d->findNextButton, SIGNAL(pressed()), this, SLOT(findNext()));
+    d->findInFolderButton = new QPushButton(QChar(fa::folderopen));
+    d->findInFolderButton->setFlat(true);
+    d->findInFolderButton->setFont(d->awesome->font(style::stfas, buttonFont.pointSize()));
+    d->findInFolderButton->setToolTip(tr("Find in folder"));
+    connect(d->findInFolderButton, SIGNAL(pressed()), this, SLOT(findInFolder()));
 
     d->replaceButton = new QPushButton(tr("Replace"));
     connect(d->replaceButton, SIGNAL(pressed()), this, SLOT(replace()));
@@ -199,6 +363,7 @@ FindReplace::FindReplace(QPlainTextEdit *editor, QWidget *parent)
     d->layout->addWidget(d->statusLabel, 0, 7, 1, 1);
     d->layout->addWidget(d->findPrevButton, 0, 8, 1, 1, Qt::AlignRight);
     d->layout->addWidget(d->findNextButton, 0, 9, 1, 1, Qt::AlignRight);
+    d->layout->addWidget(d->findInFolderButton, 0, 10, 1, 1, Qt::AlignRight);
 
     d->layout->addWidget(new QLabel(tr("Replace with:")), 1, 1, 1, 5, Qt::AlignRight);
     d->layout->addWidget(d->replaceField, 1, 6, 1, 1);
@@ -217,6 +382,7 @@ FindReplace::FindReplace(QPlainTextEdit *editor, QWidget *parent)
 
     d->findNextButton->setEnabled(false);
     d->findPrevButton->setEnabled(false);
+    d->findInFolderButton->setEnabled(false);
     d->replaceButton->setEnabled(false);
     d->replaceAllButton->setEnabled(false);
 
@@ -226,6 +392,7 @@ FindReplace::FindReplace(QPlainTextEdit *editor, QWidget *parent)
             bool enable = !text.isEmpty();
             d->findNextButton->setEnabled(enable);
             d->findPrevButton->setEnabled(enable);
+            d->findInFolderButton->setEnabled(enable);
             d->replaceButton->setEnabled(enable);
             d->replaceAllButton->setEnabled(enable);
 
@@ -237,8 +404,33 @@ FindReplace::FindReplace(QPlainTextEdit *editor, QWidget *parent)
     this->connect(d->editor->document(),
         &QTextDocument::contentsChanged,
         [this, d]() {
+            d->documentTextValid = false;
+
+            // A scan still running was started on the text before this
+            // change, so its matches would be out of place.  Search again
+            // once typing pauses rather than on every keystroke, which
+            // would snapshot the whole document each time.  The current
+            // highlights move along with the edits in the meantime.
             if (this->isVisible() && d->highlightMatchesButton->isChecked()) {
-                d->highlightMatches(true);
+                d->cancelScan();
+                d->startHighlightTimer();
+            }
+        });
+
+    d->scanWatcher = new QFutureWatcher<FindReplacePrivate::MatchList>(this);
+    d->index = new TrigramIndex(d->editor->document(), this);
+
+    this->connect(d->scanWatcher,
+        &QFutureWatcherBase::finished,
+        [d]() {
+            d->onScanFinished();
+        });
+
+    this->connect(d->editor->verticalScrollBar(),
+        &QScrollBar::valueChanged,
+        [this, d]() {
+            if (this->isVisible() && d->highlightMatchesButton->isChecked()) {
+                d->highlightVisibleMatches();
             }
         });
 
@@ -248,6 +440,8 @@ FindReplace::FindReplace(QPlainTextEdit *editor, QWidget *parent)
 FindReplace::~FindReplace()
 {
     Q_D(FindReplace);
+
+    d->cancelScan();
     
     QSettings settings;
     settings.setValue(GW_FIND_REPLACE_MATCH_CASE, d->matchCaseButton->isChecked());
@@ -363,6 +557,27 @@ void FindReplace::findPrevious()
     }
 }
 
+void FindReplace::findInFolder()
+{
+    Q_D(FindReplace);
+
+    if (!this->isVisible()) {
+        showFindView();
+    }
+
+    if (d->findField->text().isEmpty()) {
+        return;
+    }
+
+    emit findInFolderRequested
+    (
+        d->findField->text(),
+        d->matchCaseButton->isChecked(),
+        d->wholeWordButton->isChecked(),
+        d->regularExpressionButton->isChecked()
+    );
+}
+
 void FindReplace::replace()
 {
     Q_D(FindReplace);
@@ -387,50 +602,63 @@ void FindReplace::replaceAll()
     if (!this->isVisible() || !d->replaceRowVisible) {
         showReplaceView();
     }
-    
-    QTextCursor cursor = d->editor->textCursor();
-    cursor.movePosition(QTextCursor::Start);
 
-    int count = 0;
+    const FindReplacePrivate::SearchQuery &query = d->searchQuery();
+    FindReplacePrivate::MatchList matches;
+    QVector<int> candidates;
+
+    // Find every match in a snapshot of the document before changing
+    // anything, rather than searching the document again after each
+    // replacement.
+    if (query.isValid()) {
+        if (d->candidateBlocks(query, candidates)) {
+            matches = d->findMatchesInBlocks(query, candidates);
+        } else {
+            matches = FindReplacePrivate::findMatches(d->documentText(), query);
+        }
+    }
 
-    while (d->findMatch(cursor, false)) {
-        cursor.insertText(d->replaceField->text());
-        count++;
+    // Replace the matches from last to first, so that the positions of
+    // the ones left to replace stay valid.  A single edit block makes
+    // for a single undo step, and the document only notifies the editor,
+    // highlighter, spell checker, statistics and outline once it ends.
+    QString replacement = d->replaceField->text();
+    QTextCursor cursor(d->editor->document());
+    cursor.beginEditBlock();
+
+    for (int i = matches.size() - 1; i >= 0; i--) {
+        cursor.setPosition(matches[i].first);
+        cursor.setPosition(matches[i].first + matches[i].second, QTextCursor::KeepAnchor);
+        cursor.insertText(replacement);
     }
 
-    d->statusLabel->setText(tr("%Ln replacement(s)", "", count));
+    cursor.endEditBlock();
+
+    d->statusLabel->setProperty("error", matches.isEmpty());
+    d->statusLabel->setText(tr("%Ln replacement(s)", "", matches.size()));
     d->editor->setFocus();
 }
 
 bool FindReplacePrivate::findMatch(QTextCursor& cursor, bool wrap, bool backwards)
 {
-    QString searchText = this->findField->text();
+    const SearchQuery &query = searchQuery();
     QTextDocument::FindFlags findFlags;
-    QRegularExpression expr;
 
     findFlags.setFlag(QTextDocument::FindCaseSensitively, this->matchCaseButton->isChecked());
     findFlags.setFlag(QTextDocument::FindWholeWords, this->wholeWordButton->isChecked());
     findFlags.setFlag(QTextDocument::FindBackward, backwards);
 
-    if (this->regularExpressionButton->isChecked()) {
-        expr.setPattern(searchText);
-        QRegularExpression::PatternOptions options = expr.patternOptions();
-        options.setFlag(QRegularExpression::CaseInsensitiveOption,
-            !this->matchCaseButton->isChecked());
-        expr.setPatternOptions(options);
-    }
-
     bool found = false;
     int wrapCount = 0;
     this->statusLabel->setText("");
     this->statusLabel->setProperty("error", false);
 
     while (!found && (wrapCount < 2)) {
-        if (expr.pattern().isEmpty() || expr.pattern().isNull()) {
-            cursor = this->editor->document()->find(searchText, cursor, findFlags);
+        if (query.regularExpression) {
+            cursor = this->editor->document()->find(query.expr, cursor, findFlags);
         }
         else {
-            cursor = this->editor->document()->find(expr, cursor, findFlags);
+            cursor = findLiteral(query, cursor, backwards);
         }
 
         if (!cursor.isNull()) {
@@ -462,43 +690,371 @@ bool FindReplacePrivate::findMatch(QTextCursor& cursor, bool wrap, bool backward
     return found;
 }
 
+const FindReplacePrivate::SearchQuery &FindReplacePrivate::searchQuery() const
+{
+    QString text = this->findField->text();
+    bool regularExpression = this->regularExpressionButton->isChecked();
+    bool wholeWords = this->wholeWordButton->isChecked();
+    Qt::CaseSensitivity caseSensitivity =
+        this->matchCaseButton->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive;
+
+    if ((text == query.text)
+            && (regularExpression == query.regularExpression)
+            && (wholeWords == query.wholeWords)
+            && (caseSensitivity == query.caseSensitivity)) {
+        return query;
+    }
+
+    query.text = text;
+    query.regularExpression = regularExpression;
+    query.wholeWords = wholeWords;
+    query.caseSensitivity = caseSensitivity;
+
+    // Literal queries are also compiled into a regular expression, which
+    // is used for matching within blocks.
+    QRegularExpression::PatternOptions options = QRegularExpression::NoPatternOption;
+    options.setFlag(QRegularExpression::CaseInsensitiveOption, Qt::CaseInsensitive == caseSensitivity);
+
+    query.expr = QRegularExpression(
+        regularExpression ? text : QRegularExpression::escape(text), options);
+    query.expr.optimize();
+    query.matcher = QStringMatcher(text, caseSensitivity);
+
+    return query;
+}
+
+const QString &FindReplacePrivate::documentText() const
+{
+    if (!documentTextValid) {
+        documentTextCache = this->editor->toPlainText();
+        documentTextValid = true;
+    }
+
+    return documentTextCache;
+}
+
+bool FindReplacePrivate::candidateBlocks(const SearchQuery &query, QVector<int> &blockNumbers) const
+{
+    if (query.regularExpression) {
+        return false;
+    }
+
+    if (this->editor->document()->characterCount() >= GW_FIND_REPLACE_INDEX_MIN_LENGTH) {
+        this->index->build();
+    }
+
+    return this->index->candidateBlocks(query.text, blockNumbers);
+}
+
+FindReplacePrivate::MatchList FindReplacePrivate::findMatchesInBlocks
+(
+    const SearchQuery &query,
+    const QVector<int> &blockNumbers
+) const
+{
+    MatchList matches;
+
+    for (int blockNumber : blockNumbers) {
+        QTextBlock block = this->editor->document()->findBlockByNumber(blockNumber);
+        findMatchesInBlock(block.text(), block.position(), query.expr, query.wholeWords, matches);
+    }
+
+    return matches;
+}
+
+QTextCursor FindReplacePrivate::findLiteral(const SearchQuery &query, const QTextCursor &cursor, bool backwards) const
+{
+    QTextDocument *document = this->editor->document();
+    QVector<int> candidates;
+    int position = -1;
+
+    // Same starting points as QTextDocument::find().
+    if (!candidateBlocks(query, candidates)) {
+        position = findLiteralInText(documentText(),
+            backwards ? (cursor.selectionStart() - 1) : cursor.selectionEnd(),
+            query, backwards);
+    } else if (backwards) {
+        int cursorBlock = document->findBlock(cursor.selectionStart()).blockNumber();
+        auto iter = std::upper_bound(candidates.constBegin(), candidates.constEnd(), cursorBlock);
+
+        while ((position < 0) && (iter != candidates.constBegin())) {
+            --iter;
+            QTextBlock block = document->findBlockByNumber(*iter);
+            QString text = block.text();
+            int from = (*iter == cursorBlock)
+                ? (cursor.selectionStart() - block.position() - 1) : text.length();
+            int index = findLiteralInText(text, from, query, true);
+
+            if (index >= 0) {
+                position = block.position() + index;
+            }
+        }
+    } else {
+        int cursorBlock = document->findBlock(cursor.selectionEnd()).blockNumber();
+        auto iter = std::lower_bound(candidates.constBegin(), candidates.constEnd(), cursorBlock);
+
+        for (; (position < 0) && (iter != candidates.constEnd()); ++iter) {
+            QTextBlock block = document->findBlockByNumber(*iter);
+            int from = (*iter == cursorBlock) ? (cursor.selectionEnd() - block.position()) : 0;
+            int index = findLiteralInText(block.text(), from, query, false);
+
+            if (index >= 0) {
+                position = block.position() + index;
+            }
+        }
+    }
+
+    if (position < 0) {
+        return QTextCursor();
+    }
+
+    QTextCursor match(document);
+    match.setPosition(position);
+    match.setPosition(position + query.text.length(), QTextCursor::KeepAnchor);
+    return match;
+}
+
+int FindReplacePrivate::findLiteralInText(const QString &text, int from, const SearchQuery &query, bool backwards)
+{
+    int length = query.text.length();
+    int index;
+
+    if (backwards) {
+        index = (from >= 0) ? text.lastIndexOf(query.text, from, query.caseSensitivity) : -1;
+
+        while ((index >= 0) && query.wholeWords && !isWholeWord(text, index, length)) {
+            index = (index > 0) ? text.lastIndexOf(query.text, index - 1, query.caseSensitivity) : -1;
+        }
+    } else {
+        index = query.matcher.indexIn(text, from);
+
+        while ((index >= 0) && query.wholeWords && !isWholeWord(text, index, length)) {
+            index = query.matcher.indexIn(text, index + 1);
+        }
+    }
+
+    return index;
+}
+
+bool FindReplacePrivate::isWholeWord(const QString &text, int start, int length)
+{
+    int end = start + length;
+
+    return ((start <= 0) || !text.at(start - 1).isLetterOrNumber())
+        && ((end >= text.length()) || !text.at(end).isLetterOrNumber());
+}
+
+void FindReplacePrivate::findMatchesInBlock
+(
+    const QString &text,
+    int blockPosition,
+    const QRegularExpression &expr,
+    bool wholeWords,
+    QVector<QPair<int, int>> &matches
+)
+{
+    QRegularExpressionMatchIterator iter = expr.globalMatch(text);
+
+    while (iter.hasNext()) {
+        QRegularExpressionMatch match = iter.next();
+        int start = match.capturedStart();
+        int end = match.capturedEnd();
+
+        // Same word boundary rules as QTextDocument::find().
+        if (wholeWords && !isWholeWord(text, start, end - start)) {
+            continue;
+        }
+
+        matches.append(qMakePair(blockPosition + start, end - start));
+    }
+}
+
+FindReplacePrivate::MatchList FindReplacePrivate::findMatches
+(
+    const QString &text,
+    const SearchQuery &query,
+    QSharedPointer<std::atomic<bool>> canceled
+)
+{
+    MatchList matches;
+
+    if (!query.regularExpression) {
+        // A literal query cannot contain a line break, so its matches
+        // never span blocks, and the whole text can be searched at once.
+        int length = query.text.length();
+        int index = query.matcher.indexIn(text, 0);
+
+        while ((index >= 0) && (canceled.isNull() || !canceled->load())) {
+            if (!query.wholeWords || isWholeWord(text, index, length)) {
+                matches.append(qMakePair(index, length));
+                index = query.matcher.indexIn(text, index + length);
+            } else {
+                index = query.matcher.indexIn(text, index + 1);
+            }
+        }
+
+        return matches;
+    }
+
+    int blockPosition = 0;
+
+    while ((blockPosition <= text.length()) && (canceled.isNull() || !canceled->load())) {
+        int blockEnd = text.indexOf('\n', blockPosition);
+
+        if (blockEnd < 0) {
+            blockEnd = text.length();
+        }
+
+        findMatchesInBlock(text.mid(blockPosition, blockEnd - blockPosition),
+            blockPosition, query.expr, query.wholeWords, matches);
+        blockPosition = blockEnd + 1;
+    }
+
+    return matches;
+}
+
 void FindReplacePrivate::highlightMatches(bool enabled)
 {
-    // If highlights are enabled, clear any current highlights and return.
+    cancelScan();
+
+    // If highlights are disabled, clear any current highlights and return.
     if (!enabled) {
+        this->matches.clear();
         this->editor->setExtraSelections(QList<QTextEdit::ExtraSelection>());
         return;
     }
 
+    const SearchQuery &query = searchQuery();
+
+    if (!query.isValid()) {
+        highlightMatches(false);
+        return;
+    }
+
+    // When the trigram index leaves only a few blocks to search, it is
+    // quicker to search them right away than to snapshot the document.
+    QVector<int> candidates;
+
+    if (candidateBlocks(query, candidates)
+            && (candidates.size() <= GW_FIND_REPLACE_INDEX_MAX_CANDIDATES)) {
+        setMatches(findMatchesInBlocks(query, candidates));
+        return;
+    }
+
+    // The previous highlights stay in place, and move along with any
+    // edits, until the new scan has finished.
+    this->scanCanceled.reset(new std::atomic<bool>(false));
+    this->scanWatcher->setFuture
+    (
+        QtConcurrent::run
+        (
+            &FindReplacePrivate::findMatches,
+            documentText(),
+            query,
+            this->scanCanceled
+        )
+    );
+}
+
+void FindReplacePrivate::highlightVisibleMatches()
+{
     QList<QTextEdit::ExtraSelection> selections;
+
+    if (this->matches.isEmpty()) {
+        this->editor->setExtraSelections(selections);
+        return;
+    }
+
+    QRect viewportRect = this->editor->viewport()->rect();
+    QTextBlock firstBlock = this->editor->cursorForPosition(viewportRect.topLeft()).block();
+    QTextBlock lastBlock = this->editor->cursorForPosition(viewportRect.bottomRight()).block();
+
+    for (int i = 0; (i < GW_FIND_REPLACE_HIGHLIGHT_MARGIN) && firstBlock.previous().isValid(); i++) {
+        firstBlock = firstBlock.previous();
+    }
+
+    for (int i = 0; (i < GW_FIND_REPLACE_HIGHLIGHT_MARGIN) && lastBlock.next().isValid(); i++) {
+        lastBlock = lastBlock.next();
+    }
+
+    int start = firstBlock.position();
+    int end = lastBlock.position() + lastBlock.length();
+
     QColor highlightedTextColor = this->editor->palette().color(QPalette::HighlightedText);
     QColor highlightColor = this->editor->palette().color(QPalette::Highlight);
     highlightColor.setAlpha(150);
 
-    QTextCursor cursor = this->editor->textCursor();
-    cursor.movePosition(QTextCursor::Start);
-
     QTextEdit::ExtraSelection match;
     match.format.setForeground(highlightedTextColor);
     match.format.setBackground(highlightColor);
 
-    bool movedToMatch = false;
-    
-    while (findMatch(cursor, false)) {
-        match.cursor = cursor;
+    // Skip straight to the first match in range.
+    auto iter = std::lower_bound(this->matches.constBegin(), this->matches.constEnd(),
+        qMakePair(start, 0));
+
+    for (; (iter != this->matches.constEnd()) && (iter->first < end); ++iter) {
+        match.cursor = QTextCursor(this->editor->document());
+        match.cursor.setPosition(iter->first);
+        match.cursor.setPosition(iter->first + iter->second, QTextCursor::KeepAnchor);
         selections.append(match);
+    }
+
+    this->editor->setExtraSelections(selections);
+}
+
+void FindReplacePrivate::onScanFinished()
+{
+    if (this->scanWatcher->isCanceled() || this->scanCanceled.isNull()
+            || this->scanCanceled->load()) {
+        return;
+    }
+
+    this->scanCanceled.reset();
+    setMatches(this->scanWatcher->result());
+}
+
+void FindReplacePrivate::setMatches(const MatchList &matches)
+{
+    Q_Q(FindReplace);
+
+    this->matches = matches;
 
-        if (!movedToMatch && !editor->hasFocus() && (cursor >= this->editor->textCursor())) {
+    if (!q->isVisible() || !this->highlightMatchesButton->isChecked()) {
+        return;
+    }
+
+    if (this->matches.isEmpty()) {
+        this->statusLabel->setText(QObject::tr("No results"));
+        this->statusLabel->setProperty("error", true);
+    } else {
+        this->statusLabel->setText(QObject::tr("%1 matches").arg(this->matches.count()));
+        this->statusLabel->setProperty("error", false);
+    }
+
+    // While typing the query, move to the first match at or after the
+    // cursor, as if searching as you type.
+    if (!this->editor->hasFocus()) {
+        int position = this->editor->textCursor().selectionStart();
+        auto iter = std::lower_bound(this->matches.constBegin(), this->matches.constEnd(),
+            qMakePair(position, 0));
+
+        if (iter != this->matches.constEnd()) {
+            QTextCursor cursor(this->editor->document());
+            cursor.setPosition(iter->first);
+            cursor.setPosition(iter->first + iter->second, QTextCursor::KeepAnchor);
             this->editor->setTextCursor(cursor);
-            movedToMatch = true;
         }
     }
 
-    this->editor->setExtraSelections(selections);
+    highlightVisibleMatches();
+}
 
-    if (!selections.isEmpty()) {
-        this->statusLabel->setText(QObject::tr("%1 matches").arg(selections.count()));
-    }    
+void FindReplacePrivate::cancelScan()
+{
+    if (!this->scanCanceled.isNull()) {
+        this->scanCanceled->store(true);
+        this->scanCanceled.reset();
+    }
 }
 
 void FindReplacePrivate::setQueryFromSelection()
@@ -547,7 +1103,7 @@ void FindReplacePrivate::startHighlightTimer()
         this->highlightTimer->stop();
     }
 
-    this->highlightTimer->start(500);    
+    this->highlightTimer->start(GW_FIND_REPLACE_HIGHLIGHT_DELAY);    
 }
 
 void FindReplacePrivate::closeFindReplace() 
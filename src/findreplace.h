@@ -90,6 +90,12 @@ public slots:
      */
     void findPrevious();
 
+    /**
+     * Requests a search for the query in the find field across the files
+     * in the folder of the document.
+     */
+    void findInFolder();
+
     /**
      * Replaces the currently selected text in the editor with the value
      * in the replace field.
@@ -102,6 +108,19 @@ public slots:
      */
     void replaceAll();
 
+signals:
+    /**
+     * Emitted when the user asks to search for the given query, with the
+     * given options, across the files in the folder of the document.
+     */
+    void findInFolderRequested
+    (
+        const QString &query,
+        bool caseSensitive,
+        bool wholeWords,
+        bool regularExpression
+    );
+
 private:
     QScopedPointer<FindReplacePrivate> d_ptr;
 };
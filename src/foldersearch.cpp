@@ -0,0 +1,407 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <algorithm>
+#include <atomic>
+
+#include <QByteArray>
+#include <QByteArrayMatcher>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QRegularExpression>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QStringMatcher>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
+
+#include "foldersearch.h"
+
+// Files larger than this, in bytes, are skipped.  They are unlikely to be
+// hand-written Markdown.
+#define GW_FOLDER_SEARCH_MAX_FILE_SIZE (256 * 1024 * 1024)
+
+namespace ghostwriter
+{
+class FolderSearchPrivate
+{
+    Q_DECLARE_PUBLIC(FolderSearch)
+
+public:
+    struct FileMatches
+    {
+        QString filePath;
+        QVector<FolderSearch::Match> matches;
+    };
+
+    /*
+    * Searches a single file.  Copied to every thread of the pool, and
+    * only ever reads its members, so that it can be shared safely.
+    */
+    struct FileSearcher
+    {
+        typedef FileMatches result_type;
+
+        QRegularExpression expr;
+        bool literal = false;
+        bool wholeWords = false;
+        QStringMatcher matcher;
+
+        // For case sensitive literals, files that do not contain the
+        // query's UTF-8 bytes are skipped without being decoded.
+        QByteArrayMatcher bytesMatcher;
+
+        QSharedPointer<std::atomic<bool>> canceled;
+
+        FileMatches operator()(const QString &filePath) const;
+
+        /*
+        * Appends the matches in the given line to the list.
+        */
+        void findMatchesInLine
+        (
+            const QString &lineText,
+            int line,
+            QVector<FolderSearch::Match> &matches
+        ) const;
+    };
+
+    FolderSearchPrivate(FolderSearch *q_ptr)
+        : q_ptr(q_ptr),
+          listWatcher(nullptr),
+          searchWatcher(nullptr),
+          fileCount(0)
+    {
+        ;
+    }
+
+    ~FolderSearchPrivate()
+    {
+        ;
+    }
+
+    FolderSearch *q_ptr;
+    QFutureWatcher<QStringList> *listWatcher;
+    QFutureWatcher<FileMatches> *searchWatcher;
+    QSharedPointer<std::atomic<bool>> canceled;
+    FileSearcher searcher;
+    int fileCount;
+
+    /*
+    * Returns the paths of the Markdown files in the given directory and
+    * its subdirectories.  Runs on a worker thread.
+    */
+    static QStringList listFiles
+    (
+        const QString &directory,
+        QSharedPointer<std::atomic<bool>> canceled
+    );
+
+    bool isCanceled() const;
+    void onFilesListed();
+    void onResultReady(int index);
+    void onSearchFinished();
+};
+
+FolderSearch::FolderSearch(QObject *parent)
+    : QObject(parent),
+      d_ptr(new FolderSearchPrivate(this))
+{
+    Q_D(FolderSearch);
+
+    d->listWatcher = new QFutureWatcher<QStringList>(this);
+    d->searchWatcher = new QFutureWatcher<FolderSearchPrivate::FileMatches>(this);
+
+    this->connect(d->listWatcher,
+        &QFutureWatcherBase::finished,
+        [d]() {
+            d->onFilesListed();
+        });
+
+    this->connect(d->searchWatcher,
+        &QFutureWatcherBase::resultReadyAt,
+        [d](int index) {
+            d->onResultReady(index);
+        });
+
+    this->connect(d->searchWatcher,
+        &QFutureWatcherBase::finished,
+        [d]() {
+            d->onSearchFinished();
+        });
+}
+
+FolderSearch::~FolderSearch()
+{
+    cancel();
+}
+
+void FolderSearch::start
+(
+    const QString &directory,
+    const QString &query,
+    bool caseSensitive,
+    bool wholeWords,
+    bool regularExpression
+)
+{
+    Q_D(FolderSearch);
+
+    cancel();
+
+    if (query.isEmpty()) {
+        emit finished(0);
+        return;
+    }
+
+    Qt::CaseSensitivity cs = caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    QRegularExpression::PatternOptions options = QRegularExpression::NoPatternOption;
+    options.setFlag(QRegularExpression::CaseInsensitiveOption, !caseSensitive);
+
+    d->searcher = FolderSearchPrivate::FileSearcher();
+    d->searcher.expr = QRegularExpression(
+        regularExpression ? query : QRegularExpression::escape(query), options);
+    d->searcher.expr.optimize();
+    d->searcher.literal = !regularExpression;
+    d->searcher.wholeWords = wholeWords;
+    d->searcher.matcher = QStringMatcher(query, cs);
+
+    if (!d->searcher.expr.isValid()) {
+        emit finished(0);
+        return;
+    }
+
+    if (!regularExpression && caseSensitive) {
+        d->searcher.bytesMatcher = QByteArrayMatcher(query.toUtf8());
+    }
+
+    d->canceled.reset(new std::atomic<bool>(false));
+    d->searcher.canceled = d->canceled;
+    d->fileCount = 0;
+    d->listWatcher->setFuture
+    (
+        QtConcurrent::run
+        (
+            &FolderSearchPrivate::listFiles,
+            directory,
+            d->canceled
+        )
+    );
+}
+
+void FolderSearch::cancel()
+{
+    Q_D(FolderSearch);
+
+    if (!d->canceled.isNull()) {
+        d->canceled->store(true);
+        d->canceled.reset();
+        d->searchWatcher->future().cancel();
+    }
+}
+
+bool FolderSearch::isRunning() const
+{
+    Q_D(const FolderSearch);
+
+    return !d->canceled.isNull();
+}
+
+FolderSearchPrivate::FileMatches FolderSearchPrivate::FileSearcher::operator()(const QString &filePath) const
+{
+    FileMatches result;
+    result.filePath = filePath;
+
+    if (canceled->load()) {
+        return result;
+    }
+
+    QFile file(filePath);
+
+    if ((file.size() <= 0) || (file.size() > GW_FOLDER_SEARCH_MAX_FILE_SIZE)
+            || !file.open(QIODevice::ReadOnly)) {
+        return result;
+    }
+
+    // Map the file rather than reading it, so that the bytes are only
+    // copied once, when decoded, and not at all for skipped files.
+    uchar *data = file.map(0, file.size());
+    QByteArray bytes;
+
+    if (nullptr != data) {
+        bytes = QByteArray::fromRawData((const char *) data, int(file.size()));
+    } else {
+        bytes = file.readAll();
+    }
+
+    if (!bytesMatcher.pattern().isEmpty() && (bytesMatcher.indexIn(bytes) < 0)) {
+        return result;
+    }
+
+    QString text = QString::fromUtf8(bytes);
+    bytes.clear();
+
+    if (nullptr != data) {
+        file.unmap(data);
+    }
+
+    int line = 0;
+    int lineStart = 0;
+
+    while ((lineStart <= text.length()) && !canceled->load()) {
+        // Literals skip straight to the next line holding a match.
+        if (literal) {
+            int index = matcher.indexIn(text, lineStart);
+
+            if (index < 0) {
+                break;
+            }
+
+            int newLineStart = text.lastIndexOf('\n', index) + 1;
+
+            if (newLineStart > lineStart) {
+                line += std::count(text.constData() + lineStart,
+                    text.constData() + newLineStart, QChar('\n'));
+                lineStart = newLineStart;
+            }
+        }
+
+        int lineEnd = text.indexOf('\n', lineStart);
+
+        if (lineEnd < 0) {
+            lineEnd = text.length();
+        }
+
+        int length = lineEnd - lineStart;
+
+        if ((length > 0) && (text.at(lineEnd - 1) == '\r')) {
+            length--;
+        }
+
+        findMatchesInLine(text.mid(lineStart, length), line, result.matches);
+        lineStart = lineEnd + 1;
+        line++;
+    }
+
+    return result;
+}
+
+void FolderSearchPrivate::FileSearcher::findMatchesInLine
+(
+    const QString &lineText,
+    int line,
+    QVector<FolderSearch::Match> &matches
+) const
+{
+    QRegularExpressionMatchIterator iter = expr.globalMatch(lineText);
+
+    while (iter.hasNext()) {
+        QRegularExpressionMatch match = iter.next();
+        int start = match.capturedStart();
+        int end = match.capturedEnd();
+
+        // Same word boundary rules as QTextDocument::find().
+        if (wholeWords
+                && (((start > 0) && lineText.at(start - 1).isLetterOrNumber())
+                    || ((end < lineText.length()) && lineText.at(end).isLetterOrNumber()))) {
+            continue;
+        }
+
+        if (end > start) {
+            matches.append({ line, start, end - start, lineText });
+        }
+    }
+}
+
+QStringList FolderSearchPrivate::listFiles
+(
+    const QString &directory,
+    QSharedPointer<std::atomic<bool>> canceled
+)
+{
+    static const QStringList nameFilters = {
+        "*.md", "*.markdown", "*.mdown", "*.mkdn", "*.mkd", "*.mdwn",
+        "*.mdtxt", "*.mdtext", "*.Rmd"
+    };
+
+    QStringList files;
+    QDirIterator iter(directory, nameFilters, QDir::Files | QDir::Readable,
+        QDirIterator::Subdirectories);
+
+    while (iter.hasNext() && !canceled->load()) {
+        files.append(iter.next());
+    }
+
+    return files;
+}
+
+bool FolderSearchPrivate::isCanceled() const
+{
+    return this->canceled.isNull() || this->canceled->load();
+}
+
+void FolderSearchPrivate::onFilesListed()
+{
+    Q_Q(FolderSearch);
+
+    if (isCanceled()) {
+        return;
+    }
+
+    QStringList files = this->listWatcher->result();
+    this->fileCount = files.size();
+
+    if (files.isEmpty()) {
+        this->canceled.reset();
+        emit q->finished(0);
+        return;
+    }
+
+    this->searchWatcher->setFuture(QtConcurrent::mapped(files, this->searcher));
+}
+
+void FolderSearchPrivate::onResultReady(int index)
+{
+    Q_Q(FolderSearch);
+
+    if (isCanceled()) {
+        return;
+    }
+
+    FileMatches result = this->searchWatcher->resultAt(index);
+
+    if (!result.matches.isEmpty()) {
+        emit q->matchesFound(result.filePath, result.matches);
+    }
+}
+
+void FolderSearchPrivate::onSearchFinished()
+{
+    Q_Q(FolderSearch);
+
+    if (isCanceled()) {
+        return;
+    }
+
+    this->canceled.reset();
+    emit q->finished(this->fileCount);
+}
+} // namespace ghostwriter
@@ -0,0 +1,108 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef FOLDER_SEARCH_H
+#define FOLDER_SEARCH_H
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QString>
+#include <QVector>
+
+namespace ghostwriter
+{
+/**
+ * Searches every Markdown file in a folder and its subfolders for a
+ * query.  Files are memory-mapped and searched in parallel on the global
+ * thread pool, and the matches for each file are reported as soon as
+ * that file has been searched.
+ */
+class FolderSearchPrivate;
+class FolderSearch : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(FolderSearch)
+
+public:
+    /**
+     * A single match within a file.  The line is numbered from zero, so
+     * that it is also the number of the block holding the match once the
+     * file is opened.
+     */
+    struct Match
+    {
+        int line;
+        int column;
+        int length;
+        QString lineText;
+    };
+
+    /**
+     * Constructor.
+     */
+    FolderSearch(QObject *parent = nullptr);
+
+    /**
+     * Destructor.  Cancels any search in progress.
+     */
+    ~FolderSearch();
+
+    /**
+     * Starts searching the files in the given directory, canceling any
+     * search still in progress.  Whole words and regular expressions
+     * follow the same rules as the find/replace widget.
+     */
+    void start
+    (
+        const QString &directory,
+        const QString &query,
+        bool caseSensitive,
+        bool wholeWords,
+        bool regularExpression
+    );
+
+    /**
+     * Stops the search in progress, if any.  No signals are emitted for
+     * it afterwards.
+     */
+    void cancel();
+
+    /**
+     * Returns true if a search is in progress.
+     */
+    bool isRunning() const;
+
+signals:
+    /**
+     * Emitted with the matches found in a single file, in the order
+     * in which the files finish being searched.
+     */
+    void matchesFound(const QString &filePath, const QVector<FolderSearch::Match> &matches);
+
+    /**
+     * Emitted once every file has been searched.
+     */
+    void finished(int fileCount);
+
+private:
+    QScopedPointer<FolderSearchPrivate> d_ptr;
+};
+} // namespace ghostwriter
+
+#endif // FOLDER_SEARCH_H
@@ -0,0 +1,226 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QDir>
+#include <QFont>
+#include <QListWidgetItem>
+
+#include "foldersearch.h"
+#include "foldersearchwidget.h"
+
+// Maximum number of matches listed, beyond which the search is stopped.
+#define GW_FOLDER_SEARCH_MAX_MATCHES 10000
+
+// Maximum number of characters of a matching line shown in the list.
+#define GW_FOLDER_SEARCH_SNIPPET_LENGTH 80
+
+namespace ghostwriter
+{
+enum FolderSearchRole {
+    FilePathRole = Qt::UserRole,
+    LineRole,
+    ColumnRole,
+    LengthRole
+};
+
+class FolderSearchWidgetPrivate
+{
+    Q_DECLARE_PUBLIC(FolderSearchWidget)
+
+public:
+    FolderSearchWidgetPrivate(FolderSearchWidget *q_ptr)
+        : q_ptr(q_ptr),
+          search(nullptr),
+          statusItem(nullptr),
+          matchCount(0),
+          fileCount(0)
+    {
+        ;
+    }
+
+    ~FolderSearchWidgetPrivate()
+    {
+        ;
+    }
+
+    FolderSearchWidget *q_ptr;
+    FolderSearch *search;
+    QListWidgetItem *statusItem;
+    QDir directory;
+    int matchCount;
+    int fileCount;
+
+    void onMatchesFound(const QString &filePath, const QVector<FolderSearch::Match> &matches);
+    void onFinished();
+
+    /*
+    * Returns the text to list for a match, which is the part of its line
+    * around the match, trimmed to fit the sidebar.
+    */
+    static QString snippet(const FolderSearch::Match &match);
+};
+
+FolderSearchWidget::FolderSearchWidget(QWidget *parent)
+    : QListWidget(parent),
+      d_ptr(new FolderSearchWidgetPrivate(this))
+{
+    Q_D(FolderSearchWidget);
+
+    d->search = new FolderSearch(this);
+
+    this->setAlternatingRowColors(false);
+    this->setWordWrap(false);
+
+    this->connect(d->search,
+        &FolderSearch::matchesFound,
+        [d](const QString &filePath, const QVector<FolderSearch::Match> &matches) {
+            d->onMatchesFound(filePath, matches);
+        });
+
+    this->connect(d->search,
+        &FolderSearch::finished,
+        [d]() {
+            d->onFinished();
+        });
+
+    this->connect(this,
+        &QListWidget::itemActivated,
+        [this](QListWidgetItem *item) {
+            if (item->data(FilePathRole).isValid()) {
+                emit matchActivated
+                (
+                    item->data(FilePathRole).toString(),
+                    item->data(LineRole).toInt(),
+                    item->data(ColumnRole).toInt(),
+                    item->data(LengthRole).toInt()
+                );
+            }
+        });
+}
+
+FolderSearchWidget::~FolderSearchWidget()
+{
+    ;
+}
+
+void FolderSearchWidget::search
+(
+    const QString &directory,
+    const QString &query,
+    bool caseSensitive,
+    bool wholeWords,
+    bool regularExpression
+)
+{
+    Q_D(FolderSearchWidget);
+
+    d->search->cancel();
+    this->clear();
+
+    d->directory = QDir(directory);
+    d->matchCount = 0;
+    d->fileCount = 0;
+    d->statusItem = new QListWidgetItem(tr("Searching %1...").arg(QDir::toNativeSeparators(directory)));
+    d->statusItem->setFlags(Qt::NoItemFlags);
+    this->addItem(d->statusItem);
+
+    d->search->start(directory, query, caseSensitive, wholeWords, regularExpression);
+}
+
+void FolderSearchWidgetPrivate::onMatchesFound
+(
+    const QString &filePath,
+    const QVector<FolderSearch::Match> &matches
+)
+{
+    Q_Q(FolderSearchWidget);
+
+    QListWidgetItem *fileItem =
+        new QListWidgetItem(QDir::toNativeSeparators(directory.relativeFilePath(filePath)));
+    QFont font = fileItem->font();
+    font.setBold(true);
+    fileItem->setFont(font);
+    fileItem->setToolTip(QDir::toNativeSeparators(filePath));
+    fileItem->setFlags(Qt::ItemIsEnabled);
+    q->addItem(fileItem);
+    this->fileCount++;
+
+    for (const FolderSearch::Match &match : matches) {
+        if (this->matchCount >= GW_FOLDER_SEARCH_MAX_MATCHES) {
+            this->search->cancel();
+            onFinished();
+            return;
+        }
+
+        QListWidgetItem *item = new QListWidgetItem(QString("%1: %2")
+            .arg(match.line + 1).arg(snippet(match)));
+        item->setData(FilePathRole, filePath);
+        item->setData(LineRole, match.line);
+        item->setData(ColumnRole, match.column);
+        item->setData(LengthRole, match.length);
+        q->addItem(item);
+        this->matchCount++;
+    }
+}
+
+void FolderSearchWidgetPrivate::onFinished()
+{
+    Q_Q(FolderSearchWidget);
+
+    if (nullptr == this->statusItem) {
+        return;
+    }
+
+    if (this->matchCount >= GW_FOLDER_SEARCH_MAX_MATCHES) {
+        this->statusItem->setText(QObject::tr("First %1 matches in %2 files")
+            .arg(this->matchCount).arg(this->fileCount));
+    } else if (this->matchCount > 0) {
+        this->statusItem->setText(QObject::tr("%1 matches in %2 files")
+            .arg(this->matchCount).arg(this->fileCount));
+    } else {
+        this->statusItem->setText(QObject::tr("No results"));
+    }
+
+    q->scrollToTop();
+}
+
+QString FolderSearchWidgetPrivate::snippet(const FolderSearch::Match &match)
+{
+    QString text = match.lineText;
+    int start = 0;
+
+    // Keep some context before the match, but make sure the match itself
+    // is visible.
+    if ((match.column + match.length) > GW_FOLDER_SEARCH_SNIPPET_LENGTH) {
+        start = qMax(0, match.column - (GW_FOLDER_SEARCH_SNIPPET_LENGTH / 4));
+    }
+
+    text = text.mid(start, GW_FOLDER_SEARCH_SNIPPET_LENGTH).trimmed();
+
+    if (start > 0) {
+        text.prepend(QChar(0x2026));
+    }
+
+    if ((start + GW_FOLDER_SEARCH_SNIPPET_LENGTH) < match.lineText.length()) {
+        text.append(QChar(0x2026));
+    }
+
+    return text;
+}
+} // namespace ghostwriter
@@ -0,0 +1,77 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef FOLDER_SEARCH_WIDGET_H
+#define FOLDER_SEARCH_WIDGET_H
+
+#include <QListWidget>
+#include <QScopedPointer>
+#include <QString>
+
+namespace ghostwriter
+{
+/**
+ * Sidebar list of the matches for a search across the Markdown files in
+ * a folder.  Matches are listed under their file as soon as each file
+ * has been searched.
+ */
+class FolderSearchWidgetPrivate;
+class FolderSearchWidget : public QListWidget
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(FolderSearchWidget)
+
+public:
+    /**
+     * Constructor.
+     */
+    FolderSearchWidget(QWidget *parent = nullptr);
+
+    /**
+     * Destructor.
+     */
+    virtual ~FolderSearchWidget();
+
+public slots:
+    /**
+     * Clears the list, and starts searching the Markdown files in the
+     * given directory and its subdirectories for the query.
+     */
+    void search
+    (
+        const QString &directory,
+        const QString &query,
+        bool caseSensitive,
+        bool wholeWords,
+        bool regularExpression
+    );
+
+signals:
+    /**
+     * Emitted when the user selects a match, in order to open its file
+     * and navigate to it.  The line is numbered from zero.
+     */
+    void matchActivated(const QString &filePath, int line, int column, int length);
+
+private:
+    QScopedPointer<FolderSearchWidgetPrivate> d_ptr;
+};
+} // namespace ghostwriter
+
+#endif // FOLDER_SEARCH_WIDGET_H
@@ -134,6 +134,14 @@ HtmlPreview::HtmlPreview
         }
     );
 
+    this->connect
+    (
+        document,
+        &MarkdownDocument::loadingFinished,
+        this,
+        &HtmlPreview::updatePreview
+    );
+
     d->headingTagExp.setPattern("^[Hh][1-6]$");
 
     d->futureWatcher = new QFutureWatcher<QString>(this);
@@ -208,6 +216,11 @@ void HtmlPreview::updatePreview()
         return;
     }
 
+    // The preview is updated once the document has finished loading.
+    if (d->document->isLoading()) {
+        return;
+    }
+
     if (this->isVisible()) {
         // Some markdown processors don't handle empty text very well
         // and will err.  Thus, only pass in text from the document
@@ -0,0 +1,276 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QRect>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include "largefilepager.h"
+
+// Number of lines of the file held in the document at a time.
+#define GW_PAGER_WINDOW_LINES 4000
+
+// Number of bytes of the file held in the document at most, for files
+// with long lines.  The part of a window above the line it is loaded
+// around, including the lines snapped to, is kept within half of this,
+// and no line is longer than a quarter of it, so that the line always
+// fits in the window.
+#define GW_PAGER_WINDOW_SIZE (4 * LineIndex::maximumLineSize())
+
+// Another window is loaded once the view is scrolled to within this many
+// lines of either end of the current one.
+#define GW_PAGER_MARGIN_LINES 500
+
+// Number of lines a window may be moved back to start after a blank line.
+#define GW_PAGER_SNAP_LINES 100
+
+// Size in bytes past which a line is not considered blank when snapping.
+#define GW_PAGER_BLANK_LINE_SIZE 256
+
+namespace ghostwriter
+{
+class LargeFilePagerPrivate
+{
+    Q_DECLARE_PUBLIC(LargeFilePager)
+
+public:
+    LargeFilePagerPrivate(LargeFilePager *q_ptr)
+        : q_ptr(q_ptr)
+    {
+        ;
+    }
+
+    ~LargeFilePagerPrivate()
+    {
+        ;
+    }
+
+    LargeFilePager *q_ptr;
+    MarkdownEditor *editor;
+    QScopedPointer<LineIndex> index;
+
+    /*
+    * Line of the file held in the first block of the document, or -1 if
+    * no window has been loaded yet.
+    */
+    int firstLine;
+
+    /*
+    * Set while the document is being replaced, to ignore the scrolling
+    * that causes.
+    */
+    bool loadingWindow;
+
+    /*
+    * Replaces the document with the window of the file around the given
+    * line, keeping the text cursor and the line at the top of the view
+    * where they were in the file if the new window holds them.
+    */
+    void loadWindow(int line);
+
+    /*
+    * Loads another window around the view if it has been scrolled close
+    * to either end of the current one.
+    */
+    void onScrolled();
+};
+
+LargeFilePager::LargeFilePager
+(
+    MarkdownEditor *editor,
+    LineIndex *index,
+    QObject *parent
+) : QObject(parent),
+    d_ptr(new LargeFilePagerPrivate(this))
+{
+    Q_D(LargeFilePager);
+
+    d->editor = editor;
+    d->index.reset(index);
+    d->firstLine = -1;
+    d->loadingWindow = false;
+
+    editor->setReadOnly(true);
+
+    this->connect
+    (
+        editor->verticalScrollBar(),
+        &QScrollBar::valueChanged,
+        this,
+        [d]() {
+            d->onScrolled();
+        }
+    );
+
+    d->loadWindow(0);
+}
+
+LargeFilePager::~LargeFilePager()
+{
+    ;
+}
+
+int LargeFilePager::lineCount() const
+{
+    Q_D(const LargeFilePager);
+
+    return d->index->lineCount();
+}
+
+QTextBlock LargeFilePager::showLine(int line)
+{
+    Q_D(LargeFilePager);
+
+    if ((line < 0) || (line >= d->index->lineCount())) {
+        return QTextBlock();
+    }
+
+    int blockCount = d->editor->document()->blockCount();
+
+    if ((line < d->firstLine) || (line >= (d->firstLine + blockCount))) {
+        d->loadWindow(line);
+    }
+
+    return d->editor->document()->findBlockByNumber(line - d->firstLine);
+}
+
+int LargeFilePager::filePosition(int documentPosition) const
+{
+    Q_D(const LargeFilePager);
+
+    return int(d->index->position(d->firstLine) + documentPosition);
+}
+
+int LargeFilePager::cursorPosition() const
+{
+    Q_D(const LargeFilePager);
+
+    return filePosition(d->editor->textCursor().position());
+}
+
+void LargeFilePager::navigateDocument(int position)
+{
+    Q_D(LargeFilePager);
+
+    int line = d->index->lineAt(position);
+    QTextBlock block = showLine(line);
+
+    if (!block.isValid()) {
+        return;
+    }
+
+    qint64 column = qBound<qint64>(0,
+        position - d->index->position(line),
+        block.length() - 1);
+
+    d->editor->navigateDocument(block.position() + int(column));
+}
+
+void LargeFilePagerPrivate::loadWindow(int line)
+{
+    int first = line - (GW_PAGER_WINDOW_LINES / 2);
+    first = qBound(0, first, qMax(0, index->lineCount() - GW_PAGER_WINDOW_LINES));
+
+    // Where lines are long, start closer to the line, so that it still
+    // falls within the window.
+    qint64 maxOffset = index->offset(line) - (GW_PAGER_WINDOW_SIZE / 4);
+    first = qMin(line, qMax(first, index->lineAtOffset(maxOffset) + 1));
+
+    // Start after a blank line where there is one close by, so that the
+    // window is less likely to begin in the middle of a list or a code
+    // block, which would throw off its highlighting.
+    maxOffset = index->offset(line) - (GW_PAGER_WINDOW_SIZE / 2);
+
+    for (int i = 0; (i < GW_PAGER_SNAP_LINES) && (first > 0); i++) {
+        qint64 previousLineSize = index->offset(first) - index->offset(first - 1);
+
+        if (index->offset(first - 1) < maxOffset) {
+            break;
+        }
+
+        // Only short lines are decoded to find out whether they are blank.
+        if ((previousLineSize <= GW_PAGER_BLANK_LINE_SIZE)
+                && index->text(first - 1, 1).trimmed().isEmpty()) {
+            break;
+        }
+
+        first--;
+    }
+
+    if (first == firstLine) {
+        return;
+    }
+
+    QTextDocument *document = editor->document();
+    int topLine = first;
+    qint64 cursorPosition = -1;
+
+    if (firstLine >= 0) {
+        QRect viewportRect = editor->viewport()->rect();
+
+        topLine = firstLine
+            + editor->cursorForPosition(viewportRect.topLeft()).blockNumber();
+        cursorPosition = index->position(firstLine)
+            + editor->textCursor().position();
+    }
+
+    loadingWindow = true;
+    editor->setPlainText(index->text(first,
+        qMin(GW_PAGER_WINDOW_LINES, index->lineCountWithin(first, GW_PAGER_WINDOW_SIZE))));
+    document->setModified(false);
+    firstLine = first;
+
+    qint64 windowStart = index->position(firstLine);
+    qint64 windowEnd = windowStart + document->characterCount() - 1;
+    QTextBlock topBlock =
+        document->findBlockByNumber(qBound(0, topLine - firstLine, document->blockCount() - 1));
+    QTextCursor cursor(topBlock);
+
+    if ((cursorPosition >= windowStart) && (cursorPosition <= windowEnd)) {
+        cursor.setPosition(int(cursorPosition - windowStart));
+    }
+
+    editor->setTextCursor(cursor);
+    editor->verticalScrollBar()->setValue(topBlock.firstLineNumber());
+    loadingWindow = false;
+}
+
+void LargeFilePagerPrivate::onScrolled()
+{
+    if (loadingWindow) {
+        return;
+    }
+
+    QRect viewportRect = editor->viewport()->rect();
+    int top = editor->cursorForPosition(viewportRect.topLeft()).blockNumber();
+    int bottom = editor->cursorForPosition(viewportRect.bottomRight()).blockNumber();
+    int blockCount = editor->document()->blockCount();
+    bool moreAbove = firstLine > 0;
+    bool moreBelow = (firstLine + blockCount) < index->lineCount();
+
+    // Windows of long lines hold fewer lines, and so have smaller margins.
+    int margin = qMin(GW_PAGER_MARGIN_LINES, blockCount / 4);
+
+    if ((moreAbove && (top < margin))
+            || (moreBelow && (bottom >= (blockCount - margin)))) {
+        loadWindow(firstLine + top);
+    }
+}
+} // namespace ghostwriter
@@ -0,0 +1,98 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef LARGE_FILE_PAGER_H
+#define LARGE_FILE_PAGER_H
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QTextBlock>
+
+#include "lineindex.h"
+#include "markdowneditor.h"
+
+namespace ghostwriter
+{
+/**
+ * Shows a file too large to be loaded as a whole in an editor, one
+ * window of lines at a time.  The editor's document only ever holds the
+ * lines around the part of the file being viewed, and is replaced with
+ * another window as the user scrolls towards either end of it.  Since
+ * the document is parsed, highlighted and spell checked as usual, that
+ * is only ever done for the current window.
+ *
+ * Positions in the whole file are mapped to positions in the document
+ * and back, so that a position can be remembered for the file and
+ * returned to later, whichever window is showing.
+ *
+ * The editor is made read only for as long as the file is paged.
+ */
+class LargeFilePagerPrivate;
+class LargeFilePager : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(LargeFilePager)
+
+public:
+    /**
+     * Constructor.  Takes ownership of the index of the file, and shows
+     * the first window of it in the editor.
+     */
+    LargeFilePager(MarkdownEditor *editor, LineIndex *index, QObject *parent = nullptr);
+
+    /**
+     * Destructor.
+     */
+    virtual ~LargeFilePager();
+
+    /**
+     * Returns the number of lines in the file.
+     */
+    int lineCount() const;
+
+    /**
+     * Shows the window of the file around the given line, counting from
+     * zero, and returns the block of the document holding the line.
+     * Returns an invalid block if the file has no such line.
+     */
+    QTextBlock showLine(int line);
+
+    /**
+     * Returns the position in the file of the given position in the
+     * document.
+     */
+    int filePosition(int documentPosition) const;
+
+    /**
+     * Returns the position in the file of the editor's text cursor.
+     */
+    int cursorPosition() const;
+
+    /**
+     * Shows the window of the file around the given position in it, and
+     * moves the editor's text cursor there.
+     */
+    void navigateDocument(int position);
+
+private:
+    QScopedPointer<LargeFilePagerPrivate> d_ptr;
+};
+} // namespace ghostwriter
+
+#endif // LARGE_FILE_PAGER_H
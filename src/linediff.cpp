@@ -0,0 +1,239 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+#include "contenthash.h"
+#include "linediff.h"
+
+namespace ghostwriter
+{
+/*
+* Lines of a text, each ending just after its line break, except maybe
+* for the last one.
+*/
+class DiffLines
+{
+public:
+    DiffLines(const QString &text) : text(text)
+    {
+        offsets.append(0);
+
+        for (int i = 0; i < text.length(); i++) {
+            if ('\n' == text[i]) {
+                offsets.append(i + 1);
+            }
+        }
+
+        if (offsets.last() != text.length()) {
+            offsets.append(text.length());
+        }
+
+        hashes.resize(count());
+
+        for (int i = 0; i < count(); i++) {
+            hashes[i] = ContentHash::hash(
+                reinterpret_cast<const char *>(text.constData() + offsets[i]),
+                qint64(length(i)) * qint64(sizeof(QChar)));
+        }
+    }
+
+    int count() const
+    {
+        return offsets.size() - 1;
+    }
+
+    int position(int line) const
+    {
+        return offsets[line];
+    }
+
+    int length(int line) const
+    {
+        return offsets[line + 1] - offsets[line];
+    }
+
+    bool equals(int line, const DiffLines &other, int otherLine) const
+    {
+        return (hashes[line] == other.hashes[otherLine])
+            && (length(line) == other.length(otherLine))
+            && (0 == memcmp(text.constData() + offsets[line],
+                other.text.constData() + other.offsets[otherLine],
+                length(line) * sizeof(QChar)));
+    }
+
+private:
+    const QString &text;
+    QVector<int> offsets;
+    QVector<quint64> hashes;
+};
+
+QVector<LineDiff::Hunk> LineDiff::compare
+(
+    const QString &oldText,
+    const QString &newText,
+    int maxDistance
+)
+{
+    struct LineHunk
+    {
+        int oldStart;
+        int oldEnd;
+        int newStart;
+        int newEnd;
+    };
+
+    DiffLines a(oldText);
+    DiffLines b(newText);
+
+    // Trim the common lines at either end, which is all there is to most
+    // changes.
+    int start = 0;
+
+    while ((start < a.count()) && (start < b.count()) && a.equals(start, b, start)) {
+        start++;
+    }
+
+    int oldEnd = a.count();
+    int newEnd = b.count();
+
+    while ((oldEnd > start) && (newEnd > start)
+            && a.equals(oldEnd - 1, b, newEnd - 1)) {
+        oldEnd--;
+        newEnd--;
+    }
+
+    int n = oldEnd - start;
+    int m = newEnd - start;
+    QVector<LineHunk> lineHunks;
+
+    if ((0 == n) && (0 == m)) {
+        return QVector<Hunk>();
+    }
+
+    // Myers' greedy algorithm.  The furthest reaching x on each diagonal k
+    // (where k = x - y) is kept before each round d, so that the path can
+    // be traced back afterwards.  Only diagonals -d - 1 to d + 1 are
+    // kept, since no others are read when tracing back round d.
+    std::vector<std::vector<int>> trace;
+    int distance = -1;
+
+    if ((n > 0) && (m > 0)) {
+        int maxD = qMin(n + m, maxDistance);
+        int offset = maxD + 1;
+        std::vector<int> v(2 * maxD + 3, 0);
+
+        for (int d = 0; (d <= maxD) && (distance < 0); d++) {
+            trace.emplace_back(v.begin() + offset - d - 1, v.begin() + offset + d + 2);
+
+            for (int k = -d; k <= d; k += 2) {
+                int x;
+
+                if ((k == -d) || ((k != d) && (v[offset + k - 1] < v[offset + k + 1]))) {
+                    x = v[offset + k + 1];
+                } else {
+                    x = v[offset + k - 1] + 1;
+                }
+
+                int y = x - k;
+
+                while ((x < n) && (y < m) && a.equals(start + x, b, start + y)) {
+                    x++;
+                    y++;
+                }
+
+                v[offset + k] = x;
+
+                if ((x >= n) && (y >= m)) {
+                    distance = d;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (distance < 0) {
+        // Only lines were added or removed, or the texts are too far apart.
+        lineHunks.append({ 0, n, 0, m });
+    } else {
+        int x = n;
+        int y = m;
+        bool inHunk = false;
+
+        for (int d = distance; d >= 0; d--) {
+            const std::vector<int> &v = trace[d];
+            int offset = d + 1;
+            int k = x - y;
+            int previousK;
+
+            if ((k == -d) || ((k != d) && (v[offset + k - 1] < v[offset + k + 1]))) {
+                previousK = k + 1;
+            } else {
+                previousK = k - 1;
+            }
+
+            int previousX = (0 == d) ? 0 : v[offset + previousK];
+            int previousY = (0 == d) ? 0 : (previousX - previousK);
+
+            // DiffLines in common end the hunk being traced.
+            if ((x > previousX) && (y > previousY)) {
+                int snake = qMin(x - previousX, y - previousY);
+
+                x -= snake;
+                y -= snake;
+                inHunk = false;
+            }
+
+            if (d > 0) {
+                if (!inHunk) {
+                    lineHunks.append({ x, x, y, y });
+                    inHunk = true;
+                }
+
+                lineHunks.last().oldStart = previousX;
+                lineHunks.last().newStart = previousY;
+            }
+
+            x = previousX;
+            y = previousY;
+        }
+
+        std::reverse(lineHunks.begin(), lineHunks.end());
+    }
+
+    QVector<Hunk> hunks;
+    hunks.reserve(lineHunks.size());
+
+    for (const LineHunk &lineHunk : lineHunks) {
+        int oldPosition = a.position(start + lineHunk.oldStart);
+        int newPosition = b.position(start + lineHunk.newStart);
+
+        hunks.append({
+            oldPosition,
+            a.position(start + lineHunk.oldEnd) - oldPosition,
+            newPosition,
+            b.position(start + lineHunk.newEnd) - newPosition
+        });
+    }
+
+    return hunks;
+}
+} // namespace ghostwriter
@@ -0,0 +1,65 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef LINE_DIFF_H
+#define LINE_DIFF_H
+
+#include <QString>
+#include <QVector>
+
+namespace ghostwriter
+{
+/**
+ * Line-level difference between two texts, computed with Myers' O(ND)
+ * algorithm after trimming the lines the texts have in common at either
+ * end.
+ */
+class LineDiff
+{
+public:
+    /**
+     * A run of lines to replace.  Positions and lengths are in characters,
+     * and cover whole lines, including their line breaks.
+     */
+    struct Hunk
+    {
+        int oldPosition;
+        int oldLength;
+        int newPosition;
+        int newLength;
+    };
+
+    /**
+     * Returns the hunks that turn the old text into the new text, in
+     * ascending order of position.  Applying them from last to first
+     * keeps the positions of the earlier ones valid.  If the texts differ
+     * in more than maxDistance lines, the differing middle of the texts
+     * is returned as a single hunk instead, which bounds the time and
+     * memory spent on texts that have little in common.
+     */
+    static QVector<Hunk> compare
+    (
+        const QString &oldText,
+        const QString &newText,
+        int maxDistance = 1024
+    );
+};
+} // namespace ghostwriter
+
+#endif // LINE_DIFF_H
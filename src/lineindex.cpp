@@ -0,0 +1,513 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <algorithm>
+#include <climits>
+
+#include <QFile>
+#include <QObject>
+#include <QVector>
+
+#include "lineindex.h"
+
+// The character position of the start of every this many lines is kept
+// in the index.
+#define GW_LINE_INDEX_STRIDE 64
+
+// Size in bytes of the longest line a file may have to be indexed.  Lines
+// are always loaded whole, so longer ones would defeat paging the file.
+#define GW_LINE_INDEX_MAX_LINE_SIZE (4 * 1024 * 1024)
+
+namespace ghostwriter
+{
+class LineIndexPrivate
+{
+public:
+    LineIndexPrivate() : data(nullptr), size(0)
+    {
+        ;
+    }
+
+    ~LineIndexPrivate()
+    {
+        ;
+    }
+
+    QFile file;
+    const char *data;
+    qint64 size;
+
+    /*
+    * Byte offset of the start of each line in the file.
+    */
+    QVector<qint64> lineOffsets;
+
+    /*
+    * Character position of the start of every GW_LINE_INDEX_STRIDE'th
+    * line.
+    */
+    QVector<qint64> checkpoints;
+
+    /*
+    * Unmaps and closes the file, and clears the index.
+    */
+    void close();
+
+    /*
+    * Returns the byte offset of the end of the given line, just before
+    * its line break.
+    */
+    qint64 lineEnd(int line) const;
+
+    /*
+    * Returns the number of characters in the given line, including one
+    * for its line break.
+    */
+    qint64 lineLength(int line) const;
+
+    /*
+    * Returns the number of UTF-16 code units that the given UTF-8 bytes
+    * decode to.  The bytes must be valid UTF-8.
+    */
+    static qint64 utf16Length(const char *data, qint64 length);
+
+    /*
+    * Returns the number of UTF-16 code units that the given bytes decode
+    * to, or -1 if they are not valid UTF-8, in which case the count would
+    * not match the text QString::fromUtf8() decodes them to.
+    */
+    static qint64 validUtf16Length(const char *data, qint64 length);
+
+    /*
+    * Returns the first line break at or after the given start and before
+    * the given end, setting breakSize to its length in bytes, or nullptr
+    * if there is none.  These are the same breaks QTextCursor::insertText()
+    * starts a new block at: LF, CRLF, a lone CR, U+2029 PARAGRAPH SEPARATOR
+    * and the U+FDD0 and U+FDD1 frame markers.
+    */
+    static const char *findLineBreak(const char *start, const char *end,
+        int &breakSize);
+
+    /*
+    * Sets characters to the number of characters in the line of the
+    * given length in bytes, excluding its line break.  Returns false and
+    * sets error if the line cannot be indexed.
+    */
+    static bool checkLine(const char *lineStart, qint64 length,
+        qint64 &characters, QString &error);
+};
+
+LineIndex::LineIndex()
+    : d_ptr(new LineIndexPrivate())
+{
+    ;
+}
+
+LineIndex::~LineIndex()
+{
+    Q_D(LineIndex);
+
+    d->close();
+}
+
+bool LineIndex::open(const QString &filePath, QString &error)
+{
+    Q_D(LineIndex);
+
+    d->close();
+    d->file.setFileName(filePath);
+
+    if (!d->file.open(QIODevice::ReadOnly)) {
+        error = d->file.errorString();
+        return false;
+    }
+
+    d->size = d->file.size();
+    d->data = (const char *) d->file.map(0, d->size);
+
+    if (nullptr == d->data) {
+        error = d->file.errorString();
+        d->close();
+        return false;
+    }
+
+    const uchar *bytes = (const uchar *) d->data;
+    qint64 start = 0;
+
+    if ((d->size >= 3)
+            && (0xEF == bytes[0]) && (0xBB == bytes[1]) && (0xBF == bytes[2])) {
+        start = 3;
+    } else if ((d->size >= 2)
+            && (((0xFF == bytes[0]) && (0xFE == bytes[1]))
+                || ((0xFE == bytes[0]) && (0xFF == bytes[1])))) {
+        error = QObject::tr("The file is not encoded in UTF-8.");
+        d->close();
+        return false;
+    }
+
+    d->lineOffsets.append(start);
+    d->checkpoints.append(0);
+
+    const char *end = d->data + d->size;
+    const char *lineStart = d->data + start;
+    qint64 position = 0;
+
+    while (lineStart < end) {
+        int breakSize = 0;
+        const char *lineBreak =
+            LineIndexPrivate::findLineBreak(lineStart, end, breakSize);
+
+        if (nullptr == lineBreak) {
+            break;
+        }
+
+        qint64 length = 0;
+
+        if (!LineIndexPrivate::checkLine(lineStart, lineBreak - lineStart, length, error)) {
+            d->close();
+            return false;
+        }
+
+        position += length + 1;
+        lineStart = lineBreak + breakSize;
+
+        if (0 == (d->lineOffsets.size() % GW_LINE_INDEX_STRIDE)) {
+            d->checkpoints.append(position);
+        }
+
+        d->lineOffsets.append(lineStart - d->data);
+    }
+
+    // The last line has no line break, but must be checked all the same.
+    qint64 length = 0;
+
+    if (!LineIndexPrivate::checkLine(lineStart, end - lineStart, length, error)) {
+        d->close();
+        return false;
+    }
+
+    return true;
+}
+
+int LineIndex::lineCount() const
+{
+    Q_D(const LineIndex);
+
+    return int(d->lineOffsets.size());
+}
+
+QString LineIndex::text(int firstLine, int count) const
+{
+    Q_D(const LineIndex);
+
+    if ((firstLine < 0) || (firstLine >= lineCount()) || (count <= 0)) {
+        return QString();
+    }
+
+    int lastLine = qMin(firstLine + count, lineCount()) - 1;
+    qint64 start = d->lineOffsets[firstLine];
+    qint64 length = d->lineEnd(lastLine) - start;
+
+    if (length > INT_MAX) {
+        return QString();
+    }
+
+    return QString::fromUtf8(d->data + start, int(length));
+}
+
+qint64 LineIndex::offset(int line) const
+{
+    Q_D(const LineIndex);
+
+    if (line >= lineCount()) {
+        return d->size;
+    }
+
+    return d->lineOffsets[qMax(0, line)];
+}
+
+int LineIndex::lineAtOffset(qint64 offset) const
+{
+    Q_D(const LineIndex);
+
+    return int(std::upper_bound(d->lineOffsets.constBegin(),
+        d->lineOffsets.constEnd(), offset) - d->lineOffsets.constBegin()) - 1;
+}
+
+int LineIndex::lineCountWithin(int firstLine, qint64 size) const
+{
+    Q_D(const LineIndex);
+
+    if ((firstLine < 0) || (firstLine >= lineCount())) {
+        return 0;
+    }
+
+    qint64 limit = d->lineOffsets[firstLine] + size;
+
+    if (d->size <= limit) {
+        return lineCount() - firstLine;
+    }
+
+    // A line fits if the next one starts within the limit.
+    int count = lineAtOffset(limit) - firstLine;
+
+    return qMax(1, count);
+}
+
+qint64 LineIndex::maximumLineSize()
+{
+    return GW_LINE_INDEX_MAX_LINE_SIZE;
+}
+
+qint64 LineIndex::position(int line) const
+{
+    Q_D(const LineIndex);
+
+    if (lineCount() <= 0) {
+        return 0;
+    }
+
+    line = qBound(0, line, lineCount() - 1);
+
+    int checkpoint = line / GW_LINE_INDEX_STRIDE;
+    qint64 position = d->checkpoints[checkpoint];
+
+    for (int i = checkpoint * GW_LINE_INDEX_STRIDE; i < line; i++) {
+        position += d->lineLength(i);
+    }
+
+    return position;
+}
+
+int LineIndex::lineAt(qint64 position) const
+{
+    Q_D(const LineIndex);
+
+    if (lineCount() <= 0) {
+        return 0;
+    }
+
+    // Start from the last checkpoint at or before the position.
+    int checkpoint = int(std::upper_bound(d->checkpoints.constBegin(),
+        d->checkpoints.constEnd(), position) - d->checkpoints.constBegin()) - 1;
+    checkpoint = qMax(0, checkpoint);
+
+    int line = checkpoint * GW_LINE_INDEX_STRIDE;
+    qint64 lineStart = d->checkpoints[checkpoint];
+
+    while ((line + 1) < lineCount()) {
+        qint64 nextLineStart = lineStart + d->lineLength(line);
+
+        if (nextLineStart > position) {
+            break;
+        }
+
+        lineStart = nextLineStart;
+        line++;
+    }
+
+    return line;
+}
+
+void LineIndexPrivate::close()
+{
+    if (nullptr != data) {
+        file.unmap((uchar *) data);
+        data = nullptr;
+    }
+
+    file.close();
+    size = 0;
+    lineOffsets.clear();
+    checkpoints.clear();
+}
+
+qint64 LineIndexPrivate::lineEnd(int line) const
+{
+    if ((line + 1) >= lineOffsets.size()) {
+        return size;
+    }
+
+    qint64 start = lineOffsets[line];
+    qint64 end = lineOffsets[line + 1] - 1;
+
+    // The line break ends just before the next line, and its last byte
+    // tells which one it is.  A CR right before an LF is always part of
+    // the same break.
+    if ('\n' == data[end]) {
+        if ((end > start) && ('\r' == data[end - 1])) {
+            end--;
+        }
+    } else if ('\r' != data[end]) {
+        end -= 2;
+    }
+
+    return end;
+}
+
+qint64 LineIndexPrivate::lineLength(int line) const
+{
+    qint64 start = lineOffsets[line];
+
+    return utf16Length(data + start, lineEnd(line) - start) + 1;
+}
+
+const char *LineIndexPrivate::findLineBreak(const char *start,
+    const char *end, int &breakSize)
+{
+    const uchar *bytes = (const uchar *) start;
+    qint64 length = end - start;
+
+    for (qint64 i = 0; i < length; i++) {
+        uchar byte = bytes[i];
+
+        // Skip quickly past the bytes that cannot start a line break.
+        if ((byte > '\r') && (byte != 0xE2) && (byte != 0xEF)) {
+            continue;
+        }
+
+        if ('\n' == byte) {
+            breakSize = 1;
+            return start + i;
+        }
+
+        if ('\r' == byte) {
+            breakSize = (((i + 1) < length) && ('\n' == bytes[i + 1])) ? 2 : 1;
+            return start + i;
+        }
+
+        if ((i + 2) < length) {
+            bool paragraphSeparator = (0xE2 == byte)
+                && (0x80 == bytes[i + 1]) && (0xA9 == bytes[i + 2]);
+            bool frameMarker = (0xEF == byte) && (0xB7 == bytes[i + 1])
+                && ((0x90 == bytes[i + 2]) || (0x91 == bytes[i + 2]));
+
+            if (paragraphSeparator || frameMarker) {
+                breakSize = 3;
+                return start + i;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+bool LineIndexPrivate::checkLine(const char *lineStart, qint64 length,
+    qint64 &characters, QString &error)
+{
+    if (length > GW_LINE_INDEX_MAX_LINE_SIZE) {
+        error = QObject::tr("The file has lines too long to be shown in parts.");
+        return false;
+    }
+
+    characters = validUtf16Length(lineStart, length);
+
+    if (characters < 0) {
+        error = QObject::tr("The file is not encoded in UTF-8.");
+        return false;
+    }
+
+    return true;
+}
+
+qint64 LineIndexPrivate::validUtf16Length(const char *data, qint64 length)
+{
+    const uchar *bytes = (const uchar *) data;
+    qint64 count = 0;
+    qint64 i = 0;
+
+    while (i < length) {
+        uchar byte = bytes[i];
+
+        if (byte < 0x80) {
+            count++;
+            i++;
+            continue;
+        }
+
+        // Lead bytes, along with the range allowed for the byte after
+        // them, which rules out overlong forms, surrogates and code points
+        // past U+10FFFF.
+        int continuationBytes;
+        uchar low = 0x80;
+        uchar high = 0xBF;
+
+        if ((byte >= 0xC2) && (byte <= 0xDF)) {
+            continuationBytes = 1;
+        } else if ((byte >= 0xE0) && (byte <= 0xEF)) {
+            continuationBytes = 2;
+
+            if (0xE0 == byte) {
+                low = 0xA0;
+            } else if (0xED == byte) {
+                high = 0x9F;
+            }
+        } else if ((byte >= 0xF0) && (byte <= 0xF4)) {
+            continuationBytes = 3;
+
+            if (0xF0 == byte) {
+                low = 0x90;
+            } else if (0xF4 == byte) {
+                high = 0x8F;
+            }
+        } else {
+            return -1;
+        }
+
+        if ((length - i) <= continuationBytes) {
+            return -1;
+        }
+
+        if ((bytes[i + 1] < low) || (bytes[i + 1] > high)) {
+            return -1;
+        }
+
+        for (int j = 2; j <= continuationBytes; j++) {
+            if (0x80 != (bytes[i + j] & 0xC0)) {
+                return -1;
+            }
+        }
+
+        count += (3 == continuationBytes) ? 2 : 1;
+        i += continuationBytes + 1;
+    }
+
+    return count;
+}
+
+qint64 LineIndexPrivate::utf16Length(const char *data, qint64 length)
+{
+    const uchar *bytes = (const uchar *) data;
+    qint64 count = 0;
+
+    // Every byte but a continuation byte starts a character, and those
+    // starting a four byte sequence decode to a surrogate pair.
+    for (qint64 i = 0; i < length; i++) {
+        if (0x80 != (bytes[i] & 0xC0)) {
+            count++;
+        }
+
+        if (bytes[i] >= 0xF0) {
+            count++;
+        }
+    }
+
+    return count;
+}
+} // namespace ghostwriter
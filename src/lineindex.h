@@ -0,0 +1,120 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <QScopedPointer>
+#include <QString>
+#include <QtGlobal>
+
+namespace ghostwriter
+{
+/**
+ * Index of the lines of a UTF-8 text file that is mapped into memory,
+ * so that any range of lines can be decoded on demand without holding
+ * the whole file in memory as text.
+ *
+ * Lines are split at the same breaks QTextDocument splits plain text
+ * into blocks at, which besides LF and CRLF include a lone CR and
+ * U+2029 PARAGRAPH SEPARATOR, so that each line is one block.  Character
+ * positions are those the text would have in a QTextDocument holding
+ * the whole file, where each line break counts as one character.  The character position of every line is not stored,
+ * only that of every few lines, with the rest counted when needed.
+ *
+ * Opening a file can take a while for very large files, but touches
+ * nothing but the index itself, so it may be done on a worker thread.
+ */
+class LineIndexPrivate;
+class LineIndex
+{
+    Q_DECLARE_PRIVATE(LineIndex)
+    Q_DISABLE_COPY(LineIndex)
+
+public:
+    /**
+     * Constructor.
+     */
+    LineIndex();
+
+    /**
+     * Destructor.  Unmaps the file.
+     */
+    ~LineIndex();
+
+    /**
+     * Maps the file at the given path into memory and indexes its lines.
+     * Returns false and sets error if the file could not be mapped, is
+     * not valid UTF-8, or has a line longer than maximumLineSize().
+     */
+    bool open(const QString &filePath, QString &error);
+
+    /**
+     * Returns the number of lines in the file.
+     */
+    int lineCount() const;
+
+    /**
+     * Returns the given number of lines of text starting at the given
+     * line, with their line breaks as they are in the file, except for
+     * that of the last line.
+     */
+    QString text(int firstLine, int count) const;
+
+    /**
+     * Returns the byte offset in the file of the start of the given line,
+     * or the size of the file past the last line.
+     */
+    qint64 offset(int line) const;
+
+    /**
+     * Returns the line holding the byte at the given offset in the file,
+     * or -1 if the offset is before the first line.
+     */
+    int lineAtOffset(qint64 offset) const;
+
+    /**
+     * Returns the number of lines starting at the given line that fit
+     * within the given number of bytes, including their line breaks.  At
+     * least one line is counted, however long.
+     */
+    int lineCountWithin(int firstLine, qint64 size) const;
+
+    /**
+     * Returns the size in bytes of the longest line a file may have to
+     * be indexed.
+     */
+    static qint64 maximumLineSize();
+
+    /**
+     * Returns the character position of the start of the given line.
+     */
+    qint64 position(int line) const;
+
+    /**
+     * Returns the line holding the character at the given position.
+     */
+    int lineAt(qint64 position) const;
+
+private:
+    QScopedPointer<LineIndexPrivate> d_ptr;
+};
+} // namespace ghostwriter
+
+#endif // LINE_INDEX_H
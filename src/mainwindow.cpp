@@ -39,6 +39,7 @@
 #include <QSizePolicy>
 #include <QStatusBar>
 #include <QTemporaryFile>
+#include <QTextBlock>
 #include <QTextDocumentFragment>
 
 #include "3rdparty/QtAwesome/QtAwesome.h"
@@ -67,7 +68,8 @@ enum SidebarTabIndex {
     SessionStatsSidebarTab,
     DocumentStatsSidebarTab,
     CheatSheetSidebarTab,
-    LastSidebarTab = CheatSheetSidebarTab
+    FolderSearchSidebarTab,
+    LastSidebarTab = FolderSearchSidebarTab
 };
 
 #define GW_MAIN_WINDOW_GEOMETRY_KEY "Window/mainWindowGeometry"
@@ -129,8 +131,11 @@ MainWindow::MainWindow(const QString &filePath, QWidget *parent)
     buildSidebar();
 
     documentManager = new DocumentManager(editor, this);
+    documentManager->setSpellCheckDecorator(spelling);
     documentManager->setAutoSaveEnabled(appSettings->autoSaveEnabled());
     documentManager->setFileBackupEnabled(appSettings->backupFileEnabled());
+    documentManager->setFileBackupCount(appSettings->backupCount());
+    documentManager->setEditJournalEnabled(appSettings->editJournalEnabled());
     documentManager->setDraftLocation(appSettings->draftLocation());
     documentManager->setFileHistoryEnabled(appSettings->fileHistoryEnabled());
     setWindowTitle(documentManager->document()->displayName() + "[*] - " + qAppName());
@@ -233,6 +238,8 @@ MainWindow::MainWindow(const QString &filePath, QWidget *parent)
 
     connect(appSettings, SIGNAL(autoSaveChanged(bool)), documentManager, SLOT(setAutoSaveEnabled(bool)));
     connect(appSettings, SIGNAL(backupFileChanged(bool)), documentManager, SLOT(setFileBackupEnabled(bool)));
+    connect(appSettings, SIGNAL(backupCountChanged(int)), documentManager, SLOT(setFileBackupCount(int)));
+    connect(appSettings, SIGNAL(editJournalChanged(bool)), documentManager, SLOT(setEditJournalEnabled(bool)));
     connect(appSettings, SIGNAL(tabWidthChanged(int)), editor, SLOT(setTabulationWidth(int)));
     connect(appSettings, SIGNAL(insertSpacesForTabsChanged(bool)), editor, SLOT(setInsertSpacesForTabs(bool)));
     connect(appSettings, SIGNAL(useUnderlineForEmphasisChanged(bool)), editor, SLOT(setUseUnderlineForEmphasis(bool)));
@@ -275,6 +282,7 @@ MainWindow::MainWindow(const QString &filePath, QWidget *parent)
         [this]() {
             this->sessionStats->startNewSession(this->documentStats->wordCount());
             refreshRecentFiles();
+            updatePagedState();
         }
     );
 
@@ -284,6 +292,7 @@ MainWindow::MainWindow(const QString &filePath, QWidget *parent)
         &DocumentManager::documentClosed,
         [this]() {
             this->sessionStats->startNewSession(0);
+            updatePagedState();
         }
     );
 
@@ -309,6 +318,9 @@ MainWindow::MainWindow(const QString &filePath, QWidget *parent)
     statusBarWidgets.append(this->findReplace);
     this->findReplace->setVisible(false);
 
+    connect(findReplace, &FindReplace::findInFolderRequested, this, &MainWindow::findInFolder);
+    connect(folderSearchWidget, &FolderSearchWidget::matchActivated, this, &MainWindow::openFolderSearchMatch);
+
     buildMenuBar();
     buildStatusBar();
 
@@ -967,6 +979,69 @@ void MainWindow::toggleSidebarVisible(bool visible)
     adjustEditor();
 }
 
+void MainWindow::findInFolder
+(
+    const QString &query,
+    bool caseSensitive,
+    bool wholeWords,
+    bool regularExpression
+)
+{
+    MarkdownDocument *document = documentManager->document();
+
+    if (document->isNew()) {
+        MessageBoxHelper::information
+        (
+            this,
+            tr("Cannot search the folder of an untitled document."),
+            tr("Save the document to a folder first.")
+        );
+
+        return;
+    }
+
+    sidebar->setVisible(true);
+    sidebar->setCurrentTabIndex(FolderSearchSidebarTab);
+
+    folderSearchWidget->search
+    (
+        QFileInfo(document->filePath()).dir().path(),
+        query,
+        caseSensitive,
+        wholeWords,
+        regularExpression
+    );
+}
+
+void MainWindow::openFolderSearchMatch(const QString &filePath, int line, int column, int length)
+{
+    MarkdownDocument *document = documentManager->document();
+
+    if (QFileInfo(document->filePath()) != QFileInfo(filePath)) {
+        documentManager->open(filePath);
+
+        // The user may have canceled opening the file when asked to save
+        // changes to the current one.
+        if (QFileInfo(document->filePath()) != QFileInfo(filePath)) {
+            return;
+        }
+    }
+
+    QTextBlock block = documentManager->blockForLine(line);
+
+    if (!block.isValid()) {
+        return;
+    }
+
+    int position = block.position() + qMin(column, block.length() - 1);
+    editor->navigateDocument(position);
+
+    QTextCursor cursor = editor->textCursor();
+    cursor.setPosition(qMin(position + length, block.position() + block.length() - 1),
+        QTextCursor::KeepAnchor);
+    editor->setTextCursor(cursor);
+}
+
 QAction* MainWindow::createWindowAction
 (
     const QString &text,
@@ -1030,7 +1105,8 @@ void MainWindow::buildMenuBar()
     fileMenu->addAction(createWindowAction(tr("R&ename..."), documentManager, SLOT(rename())));
     fileMenu->addAction(createWindowAction(tr("Re&load from Disk..."), documentManager, SLOT(reload())));
     fileMenu->addSeparator();
-    fileMenu->addAction(createWindowAction(tr("&Export"), documentManager, SLOT(exportFile()), QKeySequence("CTRL+E")));
+    exportMenuAction = createWindowAction(tr("&Export"), documentManager, SLOT(exportFile()), QKeySequence("CTRL+E"));
+    fileMenu->addAction(exportMenuAction);
     fileMenu->addSeparator();
     QAction *quitAction = createWindowAction(tr("&Quit"), this, SLOT(quitApplication()), QKeySequence::Quit);
     quitAction->setMenuRole(QAction::QuitRole);
@@ -1134,6 +1210,15 @@ void MainWindow::buildMenuBar()
         QKeySequence::HelpContents);
     showSidebarTabAction->setShortcutContext(Qt::WindowShortcut);
     this->addAction(showSidebarTabAction);
+
+    showSidebarTabAction = viewMenu->addAction(tr("Find in F&older"),
+        this,
+        [this]() {
+            sidebar->setVisible(true);
+            sidebar->setCurrentTabIndex(FolderSearchSidebarTab);
+        });
+    showSidebarTabAction->setShortcutContext(Qt::WindowShortcut);
+    this->addAction(showSidebarTabAction);
     
     viewMenu->addSeparator();
     viewMenu->addAction(createWidgetAction(tr("Increase Font Size"), editor, SLOT(increaseFontSize()), QKeySequence("CTRL+=")));
@@ -1398,6 +1483,8 @@ void MainWindow::buildSidebar()
     outlineWidget = new OutlineWidget(editor, this);
     outlineWidget->setAlternatingRowColors(false);
 
+    folderSearchWidget = new FolderSearchWidget(this);
+
     documentStats = new DocumentStatistics((MarkdownDocument *) editor->document(), this);
     connect(documentStats, &DocumentStatistics::wordCountChanged,
             documentStatsWidget, &DocumentStatisticsWidget::setWordCount);
@@ -1459,6 +1546,12 @@ void MainWindow::buildSidebar()
     tabButton->setToolTip(tr("Cheat Sheet"));
     sidebar->addTab(tabButton, cheatSheetWidget);
 
+    tabButton = new QPushButton();
+    tabButton->setFont(this->awesome->font(style::stfas, 16));
+    tabButton->setText(QChar(fa::search));
+    tabButton->setToolTip(tr("Find in Folder"));
+    sidebar->addTab(tabButton, folderSearchWidget);
+
     // We need to set an empty style for the scrollbar in order for the
     // scrollbar CSS stylesheet to take full effect.  Otherwise, the scrollbar's
     // background color will have the Windows 98 checkered look rather than
@@ -1472,6 +1565,8 @@ void MainWindow::buildSidebar()
     sessionStatsWidget->horizontalScrollBar()->setStyle(new QCommonStyle());
     cheatSheetWidget->verticalScrollBar()->setStyle(new QCommonStyle());
     cheatSheetWidget->horizontalScrollBar()->setStyle(new QCommonStyle());
+    folderSearchWidget->verticalScrollBar()->setStyle(new QCommonStyle());
+    folderSearchWidget->horizontalScrollBar()->setStyle(new QCommonStyle());
 
     int tabIndex = QSettings().value("sidebarCurrentTab", (int)FirstSidebarTab).toInt();
 
@@ -1544,6 +1639,20 @@ void MainWindow::adjustEditor()
     this->editor->centerCursor();
 }
 
+void MainWindow::updatePagedState()
+{
+    bool paged = documentManager->isPaged();
+
+    exportMenuAction->setEnabled(!paged);
+    documentStatsWidget->setPartial(paged);
+
+    if (paged) {
+        statisticsIndicator->setToolTip(tr("Counted for the part of the file shown only"));
+    } else {
+        statisticsIndicator->setToolTip(QString());
+    }
+}
+
 void MainWindow::applyTheme()
 {
     if (!theme.name().isNull() && !theme.name().isEmpty()) {
@@ -34,6 +34,7 @@
 #include "documentstatistics.h"
 #include "documentstatisticswidget.h"
 #include "findreplace.h"
+#include "foldersearchwidget.h"
 #include "htmlpreview.h"
 #include "outlinewidget.h"
 #include "sessionstatistics.h"
@@ -100,6 +101,8 @@ private slots:
     void onAboutToShowMenuBarMenu();
     void onSidebarVisibilityChanged(bool visible);
     void toggleSidebarVisible(bool visible);
+    void findInFolder(const QString &query, bool caseSensitive, bool wholeWords, bool regularExpression);
+    void openFolderSearchMatch(const QString &filePath, int line, int column, int length);
 
 private:
     QtAwesome *awesome;
@@ -126,6 +129,7 @@ private:
     QPushButton *htmlPreviewButton;
     HtmlPreview *htmlPreview;
     QAction *htmlPreviewMenuAction;
+    QAction *exportMenuAction;
     QAction *fullScreenMenuAction;
     QPushButton *fullScreenButton;
     OutlineWidget *outlineWidget;
@@ -134,6 +138,7 @@ private:
     SessionStatistics *sessionStats;
     SessionStatisticsWidget *sessionStatsWidget;
     QListWidget *cheatSheetWidget;
+    FolderSearchWidget *folderSearchWidget;
     QAction *recentFilesActions[MAX_RECENT_FILES];
     bool menuBarMenuActivated;
     QAction *showSidebarAction;
@@ -166,6 +171,7 @@ private:
     void buildSidebar();
 
     void adjustEditor();
+    void updatePagedState();
 };
 } // namespace ghostwriter
 
@@ -203,6 +203,13 @@ void MarkdownAST::clear()
     d->root = nullptr;
 }
 
+qint64 MarkdownAST::memorySize() const
+{
+    Q_D(const MarkdownAST);
+
+    return qint64(d->arena.bytesAllocated());
+}
+
 QString MarkdownAST::toString() const
 {
     Q_D(const MarkdownAST);
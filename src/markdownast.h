@@ -91,6 +91,11 @@ public:
      */
     void clear();
 
+    /**
+     * Returns the approximate number of bytes of memory held by this AST.
+     */
+    qint64 memorySize() const;
+
     /**
      * Returns a string representation of this tree for use in debugging.
      */
@@ -38,6 +38,7 @@ public:
     QString displayName;
     QString filePath;
     bool readOnlyFlag;
+    bool loading;
     QDateTime timestamp;
     MarkdownAST *ast;
 
@@ -158,9 +159,44 @@ void MarkdownDocument::setMarkdownAST(MarkdownAST *ast)
 {
     Q_D(MarkdownDocument);
 
+    if ((nullptr != d->ast) && (ast != d->ast)) {
+        delete d->ast;
+    }
+
     d->ast = ast;
 }
 
+MarkdownAST *MarkdownDocument::takeMarkdownAST()
+{
+    Q_D(MarkdownDocument);
+
+    MarkdownAST *ast = d->ast;
+    d->ast = nullptr;
+    return ast;
+}
+
+bool MarkdownDocument::isLoading() const
+{
+    Q_D(const MarkdownDocument);
+
+    return d->loading;
+}
+
+void MarkdownDocument::setLoading(bool loading)
+{
+    Q_D(MarkdownDocument);
+
+    if (d->loading != loading) {
+        d->loading = loading;
+
+        if (loading) {
+            setMarkdownAST(nullptr);
+        } else {
+            emit loadingFinished();
+        }
+    }
+}
+
 void MarkdownDocument::clear()
 {
     QTextDocument::clear();
@@ -177,6 +213,7 @@ void MarkdownDocumentPrivate::initializeUntitledDocument()
 
     this->filePath = QString();
     this->readOnlyFlag = false;
+    this->loading = false;
     this->displayName = QObject::tr("untitled");
     this->timestamp = QDateTime::currentDateTime();
     this->ast = nullptr;
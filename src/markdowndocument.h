@@ -100,8 +100,36 @@ public:
     void setTimestamp(const QDateTime &timestamp);
 
     MarkdownAST *markdownAST() const;
+
+    /**
+     * Sets the syntax tree of the document's text, taking ownership of it
+     * and deleting the previous one.
+     */
     void setMarkdownAST(MarkdownAST *ast);
 
+    /**
+     * Returns the syntax tree of the document's text, passing ownership
+     * of it to the caller, and leaves the document without one.
+     */
+    MarkdownAST *takeMarkdownAST();
+
+    /**
+     * Returns true while the document is being filled with the contents
+     * of a file.  Anything derived from the whole document, such as its
+     * syntax tree, statistics and spell checking, should not be updated
+     * for each change while loading, but once when loadingFinished() is
+     * emitted.
+     */
+    bool isLoading() const;
+
+    /**
+     * Sets whether the document is being filled with the contents of a
+     * file.  Setting the flag deletes the syntax tree, which no longer
+     * matches the text, and clearing it emits loadingFinished().  A syntax
+     * tree set while loading is taken to be that of the loaded text.
+     */
+    void setLoading(bool loading);
+
     /**
      * Overrides base class clear() method to send cleared() signal.
      */
@@ -118,6 +146,12 @@ signals:
      */
     void cleared();
 
+    /**
+     * Emitted when the document has been filled with the contents of a
+     * file, after having been changed piece by piece while loading.
+     */
+    void loadingFinished();
+
 private:
     QScopedPointer<MarkdownDocumentPrivate> d_ptr;
 };
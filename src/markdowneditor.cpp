@@ -244,6 +244,21 @@ MarkdownEditor::MarkdownEditor
 
     d->highlighter = new MarkdownHighlighter(this, colors);
 
+    // While a file is loading, the document is neither parsed nor
+    // highlighted for each piece of it, but all at once here.  The syntax
+    // tree may already have been restored along with the text.
+    connect(textDocument,
+        &MarkdownDocument::loadingFinished,
+        this,
+        [d]() {
+            if (nullptr == d->textDocument->markdownAST()) {
+                d->parseDocument();
+            }
+
+            d->highlighter->rehighlight();
+        }
+    );
+
     d->typingPausedSignalSent = true;
     d->typingHasPaused = true;
 
@@ -1333,6 +1348,10 @@ void MarkdownEditor::onContentsChanged(int position, int charsAdded, int charsRe
     Q_UNUSED(charsAdded)
     Q_UNUSED(charsRemoved)
 
+    if (d->textDocument->isLoading()) {
+        return;
+    }
+
     d->parseDocument();
 
     // Don't use the textChanged() or contentsChanged() (no parameters) signals
@@ -147,10 +147,18 @@ void MarkdownHighlighter::highlightBlock(const QString &text)
 
     Q_D(MarkdownHighlighter);
 
+    MarkdownDocument *document = (MarkdownDocument *) this->document();
+
+    // The whole document is highlighted again once it has finished
+    // loading.
+    if (document->isLoading()) {
+        return;
+    }
+
     int line = currentBlock().blockNumber() + 1;
     int oldState = currentBlock().userState();
 
-    MarkdownAST *ast = ((MarkdownDocument *) this->document())->markdownAST();
+    MarkdownAST *ast = document->markdownAST();
     MarkdownNode *node = nullptr;
 
     if (nullptr != ast) {
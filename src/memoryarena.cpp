@@ -72,6 +72,12 @@ void MemoryArena<T>::freeAll()
 
     slotIndex = 0;
 }
+
+template<class T>
+size_t MemoryArena<T>::bytesAllocated() const
+{
+    return size_t(arena.size()) * chunkSize * sizeof(T);
+}
 } // namespace ghostwriter
 
 #endif  // MEMORY_ARENA_CPP
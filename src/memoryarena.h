@@ -62,6 +62,11 @@ public:
      */
     void freeAll();
 
+    /**
+     * Returns the number of bytes allocated for the arena's chunks.
+     */
+    size_t bytesAllocated() const;
+
 private:
     typedef QVector<T> Chunk;
     QStack<Chunk *> arena;
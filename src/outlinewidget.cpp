@@ -111,6 +111,19 @@ OutlineWidget::OutlineWidget(MarkdownEditor *editor, QWidget *parent)
         editor->document(),
         &MarkdownDocument::contentsChange,
         [d](int, int, int) {
+            if (!((MarkdownDocument *) d->editor->document())->isLoading()) {
+                d->reloadOutline();
+            }
+        }
+    );
+
+    // The editor parses the document once it has finished loading, before
+    // this is called.
+    this->connect
+    (
+        (MarkdownDocument *) editor->document(),
+        &MarkdownDocument::loadingFinished,
+        [d]() {
             d->reloadOutline();
         }
     );
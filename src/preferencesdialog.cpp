@@ -243,6 +243,26 @@ QWidget *PreferencesDialogPrivate::initializeGeneralTab()
     connect(backupCheckBox, SIGNAL(toggled(bool)), appSettings, SLOT(setBackupFileEnabled(bool)));
     savingGroupLayout->addRow(backupCheckBox);
 
+    QSpinBox *backupCountInput = new QSpinBox();
+
+    backupCountInput->setRange
+    (
+        appSettings->MIN_BACKUP_COUNT,
+        appSettings->MAX_BACKUP_COUNT
+    );
+
+    backupCountInput->setValue(appSettings->backupCount());
+    backupCountInput->setEnabled(appSettings->backupFileEnabled());
+    connect(backupCountInput, SIGNAL(valueChanged(int)), appSettings, SLOT(setBackupCount(int)));
+    connect(backupCheckBox, SIGNAL(toggled(bool)), backupCountInput, SLOT(setEnabled(bool)));
+    savingGroupLayout->addRow(tr("Backups to keep"), backupCountInput);
+
+    QCheckBox *editJournalCheckBox = new QCheckBox(tr("Keep a journal of unsaved changes"));
+    editJournalCheckBox->setCheckable(true);
+    editJournalCheckBox->setChecked(appSettings->editJournalEnabled());
+    connect(editJournalCheckBox, SIGNAL(toggled(bool)), appSettings, SLOT(setEditJournalEnabled(bool)));
+    savingGroupLayout->addRow(editJournalCheckBox);
+
     QPushButton *openDraftDirButton = new QPushButton(tr("View untitled drafts..."));
     q->connect(
         openDraftDirButton,
@@ -24,9 +24,12 @@
 #include <QString>
 #include <QStringList>
 #include <QStringRef>
+#include <QVector>
 
 namespace ghostwriter
 {
+class VerdictCache;
+
 class Dictionary
 {
 public:
@@ -35,11 +38,41 @@ public:
 
 	virtual bool isValid() const = 0;
 	virtual QStringRef check(const QString &string, int startAt) const = 0;
+
+	// Returns every misspelled word in the given string.  Override this
+	// method if the dictionary can find all of them in a single pass.
+	virtual QVector<QStringRef> checkAll(const QString &string) const
+	{
+		QVector<QStringRef> misspelled;
+		QStringRef word = check(string, 0);
+
+		while (!word.isNull()) {
+			misspelled.append(word);
+			word = check(string, word.position() + word.length());
+		}
+
+		return misspelled;
+	}
+
 	virtual QStringList suggestions(const QString &word) const = 0;
 
+	// Returns true if the dictionary may be used from several threads at
+	// once.  Dictionaries that are not are only used on the GUI thread.
+	virtual bool isThreadSafe() const
+	{
+		return true;
+	}
+
 	virtual void addToPersonal(const QString &word) = 0;
 	virtual void addToSession(const QStringList &words) = 0;
 	virtual void removeFromSession(const QStringList &words) = 0;
+
+	// Returns the word verdict cache used by this dictionary, if any,
+	// so that its hit rate can be reported.
+	virtual const VerdictCache * verdictCache() const
+	{
+		return nullptr;
+	}
 };
 } // namespace ghostwriter
 #endif
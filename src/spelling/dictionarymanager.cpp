@@ -30,9 +30,16 @@
 #include <QFile>
 #include <QRegularExpression>
 #include <QTextStream>
+#include <QtConcurrentRun>
 
 #include <algorithm>
 
+// The personal dictionary file is only appended to as words are added.
+// It is rewritten on startup once this share of its lines are duplicates
+// or blank, such as after being edited by hand or merged from another
+// machine.
+#define GW_PERSONAL_COMPACT_RATIO 0.25
+
 namespace ghostwriter
 {
 
@@ -123,16 +130,43 @@ QString DictionaryManager::availableDictionary(const QString &language) const
 	}
 }
 
-void DictionaryManager::add(const QString& word)
+QStringList DictionaryManager::personal() const
 {
-	QStringList words = personal();
+	QStringList words = m_personal.values();
+	std::sort(words.begin(), words.end(), compareWords);
+	return words;
+}
 
-    if (words.contains(word)) {
+void DictionaryManager::add(const QString& word)
+{
+	if (word.isEmpty() || m_personal.contains(word)) {
 		return;
 	}
 
-	words.append(word);
-	setPersonal(words);
+	m_personal.insert(word);
+
+	// Append the word rather than rewriting the whole file, taking care
+	// not to join it to a last line left without a line break.
+	QFile file(m_path + "/personal");
+	if (file.open(QIODevice::ReadWrite)) {
+		QByteArray line = word.toUtf8() + '\n';
+
+		if ((file.size() > 0) && file.seek(file.size() - 1) && (file.read(1) != "\n")) {
+			line.prepend('\n');
+		}
+
+		file.seek(file.size());
+		file.write(line);
+	}
+
+	QStringList words(word);
+
+	for (Dictionary *dictionary : m_dictionaries) {
+		dictionary->addToSession(words);
+	}
+
+	// Re-check documents
+	emit changed();
 }
 
 void DictionaryManager::addProviders()
@@ -167,8 +201,9 @@ void DictionaryManager::addProviders()
 Dictionary * DictionaryManager::requestDictionary(const QString &language)
 {
 	if (language.isEmpty()) {
-		// Fetch shared default dictionary
-		if (!m_defaultDictionary) {
+		// Fetch shared default dictionary, which is the fallback until it
+		// has finished loading.
+		if (!m_defaultDictionary || (DictionaryFallback::instance() == m_defaultDictionary)) {
 			m_defaultDictionary = requestDictionaryData(m_defaultLanguage);
 		}
 		return m_defaultDictionary;
@@ -228,20 +263,42 @@ void DictionaryManager::setPath(const QString& path)
 void DictionaryManager::setPersonal(const QStringList &words)
 {
 	// Check if new
-    QStringList personal = words;
-	std::sort(personal.begin(), personal.end(), compareWords);
+	QSet<QString> personal;
+
+	for (const QString &word : words) {
+		if (!word.isEmpty()) {
+			personal.insert(word);
+		}
+	}
 
 	if (personal == m_personal) {
 		return;
 	}
 
-	// Remove current personal dictionary
-	foreach (Dictionary* dictionary, m_dictionaries) {
-		dictionary->removeFromSession(m_personal);
+	// Only update the dictionary sessions with the differences.
+	QStringList removed = (m_personal - personal).values();
+	QStringList added = (personal - m_personal).values();
+
+	for (Dictionary *dictionary : m_dictionaries) {
+		if (!removed.isEmpty()) {
+			dictionary->removeFromSession(removed);
+		}
+
+		if (!added.isEmpty()) {
+			dictionary->addToSession(added);
+		}
 	}
 
 	// Update and store personal dictionary
 	m_personal = personal;
+	writePersonal();
+
+	// Re-check documents
+	emit changed();
+}
+
+void DictionaryManager::writePersonal() const
+{
 	QFile file(m_path + "/personal");
 	if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
 		QTextStream stream(&file);
@@ -250,18 +307,10 @@ void DictionaryManager::setPersonal(const QStringList &words)
 #else
 		stream.setEncoding(QStringConverter::Utf8);
 #endif
-		for (const QString &word : m_personal) {
+		for (const QString &word : personal()) {
 			stream << word << "\n";
 		}
 	}
-
-	// Add personal dictionary
-	for (Dictionary *dictionary : m_dictionaries) {
-		dictionary->addToSession(m_personal);
-	}
-
-	// Re-check documents
-	emit changed();
 }
 
 DictionaryManager::DictionaryManager()
@@ -269,6 +318,7 @@ DictionaryManager::DictionaryManager()
 	addProviders();
 
 	// Load personal dictionary
+	int lineCount = 0;
 	QFile file(m_path + "/personal");
 	if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
 		QTextStream stream(&file);
@@ -278,15 +328,37 @@ DictionaryManager::DictionaryManager()
 		stream.setEncoding(QStringConverter::Utf8);
 #endif
 		while (!stream.atEnd()) {
-			m_personal.append(stream.readLine());
+			QString word = stream.readLine();
+			lineCount++;
+
+			if (!word.isEmpty()) {
+				m_personal.insert(word);
+			}
 		}
 
-		std::sort(m_personal.begin(), m_personal.end(), compareWords);
+		file.close();
+	}
+
+	// Compact the file if it has gathered too many redundant lines.
+	int redundantLines = lineCount - m_personal.size();
+
+	if ((redundantLines > 0) && (redundantLines >= (lineCount * GW_PERSONAL_COMPACT_RATIO))) {
+		writePersonal();
 	}
 }
 
 DictionaryManager::~DictionaryManager()
 {
+	// The loaders use the providers, so let them finish first.
+	for (QFutureWatcher<Dictionary*> *watcher : m_loading) {
+		watcher->disconnect();
+		watcher->waitForFinished();
+		delete watcher->result();
+		delete watcher;
+	}
+
+	m_loading.clear();
+
 	foreach (Dictionary* dictionary, m_dictionaries) {
 		delete dictionary;
 	}
@@ -309,26 +381,83 @@ void DictionaryManager::addProvider(DictionaryProvider *provider)
 
 Dictionary* DictionaryManager::requestDictionaryData(const QString &language)
 {
-	if (!m_dictionaries.contains(language)) {
-		Dictionary *dictionary = 0;
-		for (DictionaryProvider *provider : m_providers) {
-			dictionary = provider->requestDictionary(language);
-			if (dictionary && dictionary->isValid()) {
-				break;
-			} else {
-				delete dictionary;
-				dictionary = nullptr;
+	if (m_dictionaries.contains(language)) {
+		return m_dictionaries[language];
+	}
+
+	// Providers that cannot be used from a worker thread are loaded from
+	// straight away instead.
+	for (const DictionaryProvider *provider : m_providers) {
+		if (!provider->isThreadSafe()) {
+			Dictionary *dictionary = loadDictionary(m_providers, language);
+
+			if (!dictionary) {
+				return DictionaryFallback::instance();
 			}
+
+			dictionary->addToSession(m_personal.values());
+			m_dictionaries[language] = dictionary;
+			return dictionary;
 		}
+	}
+
+	// Load the dictionary in the background, and use the fallback in the
+	// meantime.  Clients are told to request it again with changed()
+	// once it is ready.
+	if (!m_loading.contains(language)) {
+		QFutureWatcher<Dictionary*> *watcher = new QFutureWatcher<Dictionary*>(this);
+
+		connect(watcher, &QFutureWatcherBase::finished, this, [this, language]() {
+			onDictionaryLoaded(language);
+		});
 
-		if (!dictionary) {
-			return DictionaryFallback::instance();
+		m_loading.insert(language, watcher);
+		watcher->setFuture(QtConcurrent::run(&DictionaryManager::loadDictionary, m_providers, language));
+	}
+
+	return DictionaryFallback::instance();
+}
+
+Dictionary * DictionaryManager::loadDictionary(const QList<DictionaryProvider*> &providers, const QString &language)
+{
+	for (DictionaryProvider *provider : providers) {
+		Dictionary *dictionary = provider->requestDictionary(language);
+
+		if (dictionary && dictionary->isValid()) {
+			return dictionary;
 		}
 
-		dictionary->addToSession(m_personal);
-		m_dictionaries[language] = dictionary;
+		delete dictionary;
+	}
+
+	return nullptr;
+}
+
+void DictionaryManager::onDictionaryLoaded(const QString &language)
+{
+	QFutureWatcher<Dictionary*> *watcher = m_loading.take(language);
+
+	if (!watcher) {
+		return;
 	}
 
-	return m_dictionaries[language];
+	Dictionary *dictionary = watcher->result();
+	watcher->deleteLater();
+
+	if (!dictionary) {
+		return;
+	}
+
+	// Added here rather than by the loader, in case the personal
+	// dictionary changed while loading.
+	dictionary->addToSession(m_personal.values());
+	m_dictionaries[language] = dictionary;
+
+	if (language == m_defaultLanguage) {
+		m_defaultDictionary = dictionary;
+	}
+
+	// Re-check documents
+	emit changed();
 }
 } // namespace ghostwriter
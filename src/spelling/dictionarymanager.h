@@ -21,8 +21,10 @@
 #ifndef DICTIONARY_MANAGER_H
 #define DICTIONARY_MANAGER_H
 
+#include <QFutureWatcher>
 #include <QHash>
 #include <QObject>
+#include <QSet>
 #include <QStringList>
 #include <QStringRef>
 
@@ -65,13 +67,21 @@ private:
 	void addProvider(DictionaryProvider *provider);
 	Dictionary * requestDictionaryData(const QString &language);
 
+	// Loads the dictionary for the given language from the first provider
+	// that has it.  Runs on a worker thread, since parsing large Hunspell
+	// dictionaries takes a noticeable amount of time.
+	static Dictionary * loadDictionary(const QList<DictionaryProvider*> &providers, const QString &language);
+	void onDictionaryLoaded(const QString &language);
+	void writePersonal() const;
+
 private:
 	QList<DictionaryProvider*> m_providers;
 	QHash<QString, Dictionary*> m_dictionaries;
+	QHash<QString, QFutureWatcher<Dictionary*>*> m_loading;
 	Dictionary *m_defaultDictionary;
 
 	QString m_defaultLanguage;
-	QStringList m_personal;
+	QSet<QString> m_personal;
 
 	static QString m_path;
 };
@@ -85,10 +95,5 @@ inline QString DictionaryManager::path()
 {
 	return m_path;
 }
-
-inline QStringList DictionaryManager::personal() const
-{
-	return m_personal;
-}
 } // namespace ghostwriter
 #endif
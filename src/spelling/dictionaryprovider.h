@@ -37,6 +37,12 @@ public:
 	virtual QStringList availableDictionaries() const = 0;
 	virtual Dictionary * requestDictionary(const QString &language) const = 0;
 
+	// Returns true if dictionaries may be requested from a worker thread.
+	virtual bool isThreadSafe() const
+	{
+		return true;
+	}
+
 	virtual void setIgnoreNumbers(bool ignore) = 0;
 	virtual void setIgnoreUppercase(bool ignore) = 0;
 };
@@ -19,6 +19,7 @@
  ***********************************************************************/
 
 #include <string.h>
+#include <atomic>
 #include <optional>
 #include <vector>
 
@@ -26,15 +27,20 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QListIterator>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
 #include <QRegularExpression>
 #include <QStringList>
 #include <QStringRef>
+#include <QVector>
 #include <QtGlobal>
 
 #include "hunspellprovider.h"
 
 #include "dictionary.h"
 #include "dictionarymanager.h"
+#include "verdictcache.h"
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     #include <QTextCodec>
@@ -53,6 +59,10 @@
 static bool f_ignoreNumbers = false;
 static bool f_ignoreUppercase = true;
 
+// Bumped whenever an ignore option changes so that each dictionary knows
+// to invalidate its cached word verdicts.
+static std::atomic<int> f_optionsGeneration(0);
+
 namespace ghostwriter
 {
 
@@ -68,30 +78,106 @@ public:
 	}
 
 	QStringRef check(const QString &string, int startAt) const;
+	QVector<QStringRef> checkAll(const QString &string) const;
 	QStringList suggestions(const QString &word) const;
 
 	void addToPersonal(const QString &word);
 	void addToSession(const QStringList &words);
 	void removeFromSession(const QStringList &words);
 
+	const VerdictCache * verdictCache() const
+	{
+		return &m_cache;
+	}
+
 private:
 	Hunspell *m_dictionary;
+	mutable VerdictCache m_cache;
+	mutable std::atomic<int> m_optionsGeneration;
+
+	// Hunspell and the text encoders are not thread-safe, but the
+	// document may be checked from several worker threads at once.
+	// Only cache misses need to take this lock.
+	mutable QMutex m_mutex;
+
+	// Dictionary encodings that words can be converted to directly,
+	// without going through the text codec.
+	enum Encoding {
+		OtherEncoding,
+		Latin1Encoding,
+		Utf8Encoding
+	};
+
+	Encoding m_encoding;
+
+	// Reused for every word passed to Hunspell.  Guarded by m_mutex.
+	mutable std::string m_scratch;
+
+	// Suggestions can take hundreds of milliseconds, and are prefetched
+	// on a worker thread.  They are made by a second Hunspell instance
+	// with its own lock, created on first use, so that they never hold
+	// up checking words as the user types.
+	QString m_affPath;
+	QString m_dicPath;
+	mutable Hunspell *m_suggester;
+	mutable QMutex m_suggestMutex;
+
+	// Words added to (true) or removed from (false) the session, in
+	// order, that are yet to be applied to the suggester.  Guarded by
+	// m_sessionMutex, which is never held for long.
+	mutable QVector<QPair<bool, QString>> m_pendingSessionWords;
+	QStringList m_sessionWords;
+	mutable QMutex m_sessionMutex;
+
+	// Records words added to or removed from the session, for the
+	// suggester to pick up the next time it is used.
+	void recordSessionChange(bool added, const QStringList &words);
+
+	// Creates a Hunspell instance for the dictionary files.
+	static Hunspell *createHunspell(const QString &aff, const QString &dic);
+
+	// Creates the suggester if needed and brings its session words up to
+	// date.  Must be called with m_suggestMutex held.
+	void prepareSuggester() const;
+
+	bool spell(const QString &word) const;
+
+	// Encodes the word into the given string without allocating, if the
+	// dictionary encoding allows.  Returns false if the text codec has to
+	// be used instead.
+	bool encode(const QString &word, std::string &encoded) const;
+
+	// Checks the words in the given string starting at the given index.
+	// If misspelled is null, returns the first misspelled word found.
+	// Otherwise, appends every misspelled word to it and returns a null
+	// reference.
+	QStringRef checkWords(const QString &string, int startAt,
+		QVector<QStringRef> *misspelled) const;
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 	QTextCodec *m_codec;
 #else
     QStringEncoder *m_encoder;
     QStringDecoder *m_decoder;
+
+    // Used by the suggester only.  Guarded by m_suggestMutex.
+    QStringEncoder *m_suggestEncoder;
+    QStringDecoder *m_suggestDecoder;
 #endif
 };
 
 DictionaryHunspell::DictionaryHunspell(const QString &language) :
 	m_dictionary(nullptr),
+	m_optionsGeneration(f_optionsGeneration.load()),
+	m_encoding(OtherEncoding),
+	m_suggester(nullptr),
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 	m_codec(nullptr)
 #else
     m_encoder(nullptr),
-    m_decoder(nullptr)
+    m_decoder(nullptr),
+    m_suggestEncoder(nullptr),
+    m_suggestDecoder(nullptr)
 #endif
 {
 	// Find dictionary files
@@ -110,12 +196,17 @@ DictionaryHunspell::DictionaryHunspell(const QString &language) :
 	}
 
 	// Create dictionary
-#ifndef Q_WIN32
-	m_dictionary = new Hunspell(QFile::encodeName(aff).constData(), QFile::encodeName(dic).constData());
-#else
-	m_dictionary = new Hunspell( ("\\\\?\\" + QDir::toNativeSeparators(aff)).toUtf8().toStdString(),
-			("\\\\?\\" + QDir::toNativeSeparators(dic)).toUtf8().constData() );
-#endif
+	m_affPath = aff;
+	m_dicPath = dic;
+	m_dictionary = createHunspell(aff, dic);
+	QByteArray encodingName = QByteArray(m_dictionary->get_dic_encoding()).toUpper();
+
+	if ("UTF-8" == encodingName) {
+		m_encoding = Utf8Encoding;
+	} else if (("ISO8859-1" == encodingName) || ("ISO-8859-1" == encodingName)) {
+		m_encoding = Latin1Encoding;
+	}
+
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 	m_codec = QTextCodec::codecForName(m_dictionary->get_dic_encoding());
 
@@ -133,6 +224,8 @@ DictionaryHunspell::DictionaryHunspell(const QString &language) :
     } else {
         m_encoder = new QStringEncoder(encoding.value());
         m_decoder = new QStringDecoder(encoding.value());
+        m_suggestEncoder = new QStringEncoder(encoding.value());
+        m_suggestDecoder = new QStringDecoder(encoding.value());
     }
 #endif
 }
@@ -144,6 +237,11 @@ DictionaryHunspell::~DictionaryHunspell()
        m_dictionary = nullptr;
     }
 
+    if (nullptr != m_suggester) {
+        delete m_suggester;
+        m_suggester = nullptr;
+    }
+
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
     if (nullptr != m_encoder) {
         delete m_encoder;
@@ -154,15 +252,108 @@ DictionaryHunspell::~DictionaryHunspell()
         delete m_decoder;
         m_decoder = nullptr;
     }
+
+    if (nullptr != m_suggestEncoder) {
+        delete m_suggestEncoder;
+        m_suggestEncoder = nullptr;
+    }
+
+    if (nullptr != m_suggestDecoder) {
+        delete m_suggestDecoder;
+        m_suggestDecoder = nullptr;
+    }
+#endif
+}
+
+Hunspell *DictionaryHunspell::createHunspell(const QString &aff, const QString &dic)
+{
+#ifndef Q_WIN32
+	return new Hunspell(QFile::encodeName(aff).constData(), QFile::encodeName(dic).constData());
+#else
+	return new Hunspell( ("\\\\?\\" + QDir::toNativeSeparators(aff)).toUtf8().toStdString(),
+			("\\\\?\\" + QDir::toNativeSeparators(dic)).toUtf8().constData() );
+#endif
+}
+
+void DictionaryHunspell::recordSessionChange(bool added, const QStringList &words)
+{
+    QMutexLocker locker(&m_sessionMutex);
+
+    for (const QString &word : words) {
+        if (added) {
+            m_sessionWords.append(word);
+        } else {
+            m_sessionWords.removeAll(word);
+        }
+
+        if (nullptr != m_suggester) {
+            m_pendingSessionWords.append(qMakePair(added, word));
+        }
+    }
+}
+
+void DictionaryHunspell::prepareSuggester() const
+{
+    QVector<QPair<bool, QString>> pending;
+
+    if (nullptr == m_suggester) {
+        // Loading the dictionary takes a while, so do it before taking
+        // the lock the GUI thread may need.
+        Hunspell *suggester = createHunspell(m_affPath, m_dicPath);
+        QMutexLocker locker(&m_sessionMutex);
+
+        m_suggester = suggester;
+
+        for (const QString &word : m_sessionWords) {
+            pending.append(qMakePair(true, word));
+        }
+
+        m_pendingSessionWords.clear();
+    } else {
+        QMutexLocker locker(&m_sessionMutex);
+        pending.swap(m_pendingSessionWords);
+    }
+
+    for (const QPair<bool, QString> &change : pending) {
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        std::string encoded = m_codec->fromUnicode(change.second).toStdString();
+#else
+        std::string encoded = QByteArray(m_suggestEncoder->encode(change.second)).toStdString();
 #endif
+
+        if (change.first) {
+            m_suggester->add(encoded);
+        } else {
+            m_suggester->remove(encoded);
+        }
+    }
 }
 
 QStringRef DictionaryHunspell::check(const QString &string, int startAt) const
+{
+    return checkWords(string, startAt, nullptr);
+}
+
+QVector<QStringRef> DictionaryHunspell::checkAll(const QString &string) const
+{
+    QVector<QStringRef> misspelled;
+    checkWords(string, 0, &misspelled);
+    return misspelled;
+}
+
+QStringRef DictionaryHunspell::checkWords(const QString &string, int startAt,
+    QVector<QStringRef> *misspelled) const
 {
     // Incorporated ghostwriter's word splitting algorithm into the original
     // FocusWriter algorithm to ensure hyphenated words are counted as one
     // word.
 
+    int optionsGeneration = f_optionsGeneration.load();
+
+    if (m_optionsGeneration.exchange(optionsGeneration) != optionsGeneration) {
+        m_cache.invalidate();
+    }
+
     bool inWord = false;
     int separatorCount = 0;
     int wordLen = 0;
@@ -241,21 +432,28 @@ QStringRef DictionaryHunspell::check(const QString &string, int startAt) const
         if (isWord && (index >= 0)) {
             if (!isUppercase && !isNumber) {
                 QStringRef check(&string, index, wordLen);
-                QString word = check.toString();
-
-                // Replace any fancy single quotes with a "normal" single quote.
-                word.replace(QChar(0x2019), QLatin1Char('\''));
 
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-                if (!m_dictionary->spell(m_codec->fromUnicode(word).toStdString())) {
-                    return check;
+                // Copy the word into a buffer that is reused for every
+                // word checked on this thread, replacing any fancy single
+                // quotes with a "normal" single quote on the way.  Unless
+                // the buffer is still shared with the verdict cache after
+                // a miss, this does not allocate.
+                static thread_local QString word;
+                word.resize(wordLen);
+                QChar *out = word.data();
+                const QChar *in = check.constData();
+
+                for (int j = 0; j < wordLen; j++) {
+                    out[j] = (QChar(0x2019) == in[j]) ? QChar('\'') : in[j];
                 }
-#else
-                QByteArray encoded = m_encoder->encode(word);
-                if (!m_dictionary->spell(encoded.toStdString())) {
-                    return check;
+
+                if (!spell(word)) {
+                    if (nullptr == misspelled) {
+                        return check;
+                    }
+
+                    misspelled->append(check);
                 }
-#endif
             }
 
             index = -1;
@@ -280,19 +478,22 @@ QStringList DictionaryHunspell::suggestions(const QString &word) const
 	check.replace(QChar(0x2019), QLatin1Char('\''));
 
 	std::vector<std::string> suggestions;
+	QMutexLocker locker(&m_suggestMutex);
+
+	prepareSuggester();
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-	suggestions = m_dictionary->suggest(m_codec->fromUnicode(check).toStdString());
+	suggestions = m_suggester->suggest(m_codec->fromUnicode(check).toStdString());
 #else
-    QByteArray encoded = m_encoder->encode(word);
-    suggestions = m_dictionary->suggest(encoded.toStdString());
+    QByteArray encoded = m_suggestEncoder->encode(check);
+    suggestions = m_suggester->suggest(encoded.toStdString());
 #endif
 
     for (const std::string &suggestion : suggestions) {
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
         QString word = m_codec->toUnicode(suggestion.c_str());
 #else
-        QString word = m_decoder->decode(suggestion.c_str());
+        QString word = m_suggestDecoder->decode(suggestion.c_str());
 #endif
 		result.append(word);
 	}
@@ -302,6 +503,8 @@ QStringList DictionaryHunspell::suggestions(const QString &word) const
 
 void DictionaryHunspell::addToPersonal(const QString &word)
 {
+    m_cache.invalidate();
+
     // Replace any fancy single quotes with a "normal" single quote.
     QString sanitized = word;
     sanitized.replace(QChar(0x2019), QLatin1Char('\''));
@@ -311,6 +514,11 @@ void DictionaryHunspell::addToPersonal(const QString &word)
 
 void DictionaryHunspell::addToSession(const QStringList &words)
 {
+	recordSessionChange(true, words);
+
+	QMutexLocker locker(&m_mutex);
+	m_cache.invalidate();
+
 	for (const QString &word : words) {
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 		m_dictionary->add(m_codec->fromUnicode(word).toStdString());
@@ -323,6 +531,11 @@ void DictionaryHunspell::addToSession(const QStringList &words)
 
 void DictionaryHunspell::removeFromSession(const QStringList &words)
 {
+	recordSessionChange(false, words);
+
+	QMutexLocker locker(&m_mutex);
+	m_cache.invalidate();
+
 	for (const QString &word : words) {
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 		m_dictionary->remove(m_codec->fromUnicode(word).toStdString());
@@ -333,6 +546,93 @@ void DictionaryHunspell::removeFromSession(const QStringList &words)
 	}
 }
 
+bool DictionaryHunspell::spell(const QString &word) const
+{
+    // Common words such as "the" occur thousands of times in a document,
+    // so skip encoding the word and calling into Hunspell if its verdict
+    // is already known.
+    VerdictCache::Verdict verdict = m_cache.lookup(word);
+
+    if (VerdictCache::Unknown != verdict) {
+        return (VerdictCache::Correct == verdict);
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    if (!encode(word, m_scratch)) {
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        m_scratch = m_codec->fromUnicode(word).toStdString();
+#else
+        m_scratch = QByteArray(m_encoder->encode(word)).toStdString();
+#endif
+    }
+
+    bool correct = m_dictionary->spell(m_scratch);
+
+    m_cache.insert(word, correct);
+    return correct;
+}
+
+bool DictionaryHunspell::encode(const QString &word, std::string &encoded) const
+{
+    const QChar *chars = word.constData();
+    int length = word.length();
+
+    // Clearing the string keeps its capacity, so once it has grown
+    // to fit the longest word, encoding does not allocate.
+    encoded.clear();
+
+    switch (m_encoding) {
+    case Latin1Encoding:
+        for (int i = 0; i < length; i++) {
+            ushort c = chars[i].unicode();
+
+            if (c > 0xff) {
+                // Leave replacement characters to the codec.
+                return false;
+            }
+
+            encoded.push_back(char(c));
+        }
+
+        return true;
+    case Utf8Encoding:
+        for (int i = 0; i < length; i++) {
+            uint c = chars[i].unicode();
+
+            if (QChar::isHighSurrogate(c)
+                    && ((i + 1) < length)
+                    && chars[i + 1].isLowSurrogate()) {
+                c = QChar::surrogateToUcs4(ushort(c), chars[i + 1].unicode());
+                i++;
+            } else if (QChar::isSurrogate(c)) {
+                // Leave lone surrogates to the codec.
+                return false;
+            }
+
+            if (c < 0x80) {
+                encoded.push_back(char(c));
+            } else if (c < 0x800) {
+                encoded.push_back(char(0xc0 | (c >> 6)));
+                encoded.push_back(char(0x80 | (c & 0x3f)));
+            } else if (c < 0x10000) {
+                encoded.push_back(char(0xe0 | (c >> 12)));
+                encoded.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+                encoded.push_back(char(0x80 | (c & 0x3f)));
+            } else {
+                encoded.push_back(char(0xf0 | (c >> 18)));
+                encoded.push_back(char(0x80 | ((c >> 12) & 0x3f)));
+                encoded.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+                encoded.push_back(char(0x80 | (c & 0x3f)));
+            }
+        }
+
+        return true;
+    default:
+        return false;
+    }
+}
+
 HunspellProvider::HunspellProvider()
 {
 	QStringList dictdirs = QDir::searchPaths("dict");
@@ -385,11 +685,13 @@ Dictionary * HunspellProvider::requestDictionary(const QString &language) const
 void HunspellProvider::setIgnoreNumbers(bool ignore)
 {
 	f_ignoreNumbers = ignore;
+	f_optionsGeneration++;
 }
 
 void HunspellProvider::setIgnoreUppercase(bool ignore)
 {
 	f_ignoreUppercase = ignore;
+	f_optionsGeneration++;
 }
 
 } // namespace ghostwriter
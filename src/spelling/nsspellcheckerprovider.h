@@ -36,6 +36,12 @@ public:
 		return true;
 	}
 
+	// NSSpellChecker is not documented to be thread-safe.
+	bool isThreadSafe() const
+	{
+		return false;
+	}
+
 	QStringList availableDictionaries() const;
 	AbstractDictionary* requestDictionary(const QString &language) const;
 
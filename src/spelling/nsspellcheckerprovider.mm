@@ -55,6 +55,12 @@ public:
 		return true;
 	}
 
+	// NSSpellChecker is not documented to be thread-safe.
+	bool isThreadSafe() const
+	{
+		return false;
+	}
+
 	QStringRef check(const QString &string, int start_at) const;
 	QStringList suggestions(const QString &word) const;
 
@@ -19,8 +19,14 @@
 
 #include <QAction>
 #include <QContextMenuEvent>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QMenu>
+#include <QRegularExpression>
+#include <QScrollBar>
+#include <QSet>
 #include <QStringList>
+#include <QTextBlock>
 #include <QTextCharFormat>
 #include <QTextCursor>
 #include <QTextLayout>
@@ -31,7 +37,36 @@
 
 #include "dictionary.h"
 #include "dictionarymanager.h"
+#include "markdownast.h"
+#include "markdowndocument.h"
+#include "markdownnode.h"
 #include "spellchecker.h"
+#include "suggestioncache.h"
+
+// Structure of a block that has not been looked at yet.
+#define GW_BLOCK_STRUCTURE_UNKNOWN -1
+
+// Structure of a block in a code or HTML block whose end is unknown.
+#define GW_BLOCK_STRUCTURE_OPEN_ENDED -2
+
+// Number of blocks above and below the viewport to check along with the
+// visible blocks, so that small scrolls do not reveal unchecked text.
+#define GW_SPELL_CHECK_VIEWPORT_MARGIN 20
+
+// Delay after the last edit or scroll before off-screen blocks are
+// checked in the background.
+#define GW_SPELL_CHECK_IDLE_DELAY 250
+
+// Maximum time in milliseconds to spend checking off-screen blocks
+// before yielding back to the event loop.
+#define GW_SPELL_CHECK_IDLE_SLICE 15
+
+// Delay after the last edit or scroll before suggestions for the
+// misspelled words in view are computed in the background.
+#define GW_SPELL_CHECK_PREFETCH_DELAY 500
+
+// Maximum number of misspelled words in view to prefetch suggestions for.
+#define GW_SPELL_CHECK_PREFETCH_LIMIT 50
 
 namespace ghostwriter
 {
@@ -44,7 +79,16 @@ public:
     SpellCheckDecoratorPrivate(SpellCheckDecorator *decorator)
     : q_ptr(decorator),
       spellCheckEnabled(true),
-      dictionary(DictionaryManager::instance()->requestDictionary())
+      dictionary(DictionaryManager::instance()->requestDictionary()),
+      pendingCount(0),
+      nextBlockId(1),
+      idleScanIndex(0),
+      idleTimer(nullptr),
+      prefetchTimer(nullptr),
+      htmlTagRegex("<[^<>\\s][^<>]*>"),
+      linkDestinationRegex("\\]\\(([^)]*)\\)"),
+      urlRegex("(?:[A-Za-z][A-Za-z0-9+.-]*://|www\\.)[^\\s<>]*"
+          "|[\\w.+-]+@[\\w-]+\\.[\\w.-]+")
     {
         ;
     }
@@ -54,21 +98,187 @@ public:
     QPlainTextEdit *editor;
     bool spellCheckEnabled;
     Dictionary *dictionary;
+
+    // Language of the dictionary, or empty for the default language.
+    QString language;
     QColor errorColor;
 
+    struct BlockState
+    {
+        // Whether the block still needs to be spell checked.
+        bool pending;
+
+        // Identifies the block in the misspelled word index.  Unlike the
+        // block number, it does not change as blocks are inserted or
+        // removed above the block.
+        quint32 id;
+
+        // The code or HTML block the block was in when last looked at, as
+        // returned by blockStructure().
+        int structure;
+    };
+
+    // Spell check state of each block, indexed by block number.  Only
+    // blocks in or near the viewport are checked right away.  The rest
+    // are checked as they scroll into view or in small time slices while
+    // the editor is idle.
+    QVector<BlockState> blockStates;
+    int pendingCount;
+    quint32 nextBlockId;
+    int idleScanIndex;
+    QTimer *idleTimer;
+
+    // Suggestions for the misspelled words in view are computed ahead of
+    // time, so that the context menu opens without delay.
+    SuggestionCache suggestionCache;
+    QTimer *prefetchTimer;
+
+    // Inverted index of lower case misspelled words to the ids of the
+    // blocks in which they occur, along with its reverse mapping.  This
+    // allows only the affected blocks to be re-checked when a word is
+    // added to the dictionary or ignored.
+    QHash<QString, QSet<quint32>> misspelledWordIndex;
+    QHash<quint32, QStringList> blockMisspellings;
+
+    QRegularExpression htmlTagRegex;
+    QRegularExpression linkDestinationRegex;
+    QRegularExpression urlRegex;
+
     QMenu * createContextMenu(const QTextCursor &cursorForWord) const;
 
     QMenu * createSpellingMenu(
         const QString &misspelledWord,
-        const QTextCursor &cursorForWord) const;
+        const QTextCursor &cursorForWord);
 
     QString getMisspelledWordAtCursor(QTextCursor &cursorForWord) const;
 
     void onContentsChanged(int position, int charsAdded, int charsRemoved);
-    void spellCheckBlock(QTextBlock &block) const;
-    void clearSpellCheckFormatting(QTextBlock &block) const;
-    void resetLiveSpellChecking() const;
 
+    /*
+    * Spell checks the given block, replacing its spelling error formatting
+    * with a single layout update.  Returns the misspelled words found in
+    * lower case.
+    */
+    QStringList spellCheckBlock(QTextBlock &block) const;
+
+    /*
+    * Returns a copy of the block's text in which everything but prose is
+    * blanked out with spaces, so that code spans, inline HTML and URLs are
+    * never handed to the dictionary while the positions of the remaining
+    * words stay the same.  The document's Markdown AST tells which of
+    * these constructs occur in the block.  Returns a null string if the
+    * block has no prose at all, such as a line in a code block.
+    */
+    QString spellCheckableText(const QTextBlock &block) const;
+
+    /*
+    * Returns 0 if the given block is outside of any code or HTML block.
+    * Otherwise returns one more than the number of lines left until the
+    * end of the code or HTML block, which stays the same when lines are
+    * inserted or removed above it, but changes when a fence is opened or
+    * closed above it.  Returns GW_BLOCK_STRUCTURE_OPEN_ENDED if the end
+    * of the code or HTML block is unknown.
+    */
+    int blockStructure(const QTextBlock &block) const;
+
+    /*
+    * Blanks out the code spans in the given text.
+    */
+    void maskCodeSpans(QString &text) const;
+
+    /*
+    * Blanks out the matches of the given regular expression in the given
+    * text.  If a capture group is provided, only the group is blanked out.
+    */
+    void maskMatches(
+        QString &text,
+        const QRegularExpression &regex,
+        int group = 0) const;
+
+    void clearSpellCheckFormatting(QTextBlock &block) const;
+    void resetLiveSpellChecking();
+
+    /*
+    * Requests the dictionary for the decorator's language again, and
+    * re-checks the document if it is a different one.
+    */
+    void updateDictionary();
+
+    /*
+    * Marks every block in the document as needing a spell check, checks
+    * the blocks in view, and schedules the rest for idle time.
+    */
+    void markAllBlocksPending();
+
+    /*
+    * Marks only the blocks with text as needing a spell check.  Used when
+    * switching dictionaries, since blank blocks cannot have errors.
+    */
+    void markNonEmptyBlocksPending();
+
+    /*
+    * Marks only the blocks in which the given word was found to be
+    * misspelled as needing a spell check.
+    */
+    void markBlocksPendingForWord(const QString &word);
+
+    /*
+    * Marks the blocks with text after the given block whose structure
+    * has changed as needing a spell check, up to the first block whose
+    * structure is as it was.  Used after an edit, which may have opened
+    * or closed a code or HTML block, changing what counts as prose
+    * further down.
+    */
+    void markFollowingBlocksPending(int blockNumber);
+
+    /*
+    * Sets the pending flag of the block with the given number, keeping
+    * the pending count up to date.
+    */
+    void setBlockPending(int blockNumber, bool pending);
+
+    /*
+    * Returns a new block state with a unique id.
+    */
+    BlockState createBlockState(bool pending);
+
+    /*
+    * Removes the block with the given id from the misspelled word index.
+    */
+    void forgetMisspellings(quint32 blockId);
+
+    /*
+    * Clears the misspelled word index.
+    */
+    void clearMisspellings();
+
+    /*
+    * Clears the old spell check formatting of the given block and checks
+    * it again if it is pending.
+    */
+    void checkPendingBlock(QTextBlock &block);
+
+    /*
+    * Checks any pending blocks that are in or near the viewport.
+    */
+    void checkVisibleBlocks();
+
+    /*
+    * Checks pending blocks for a single time slice, rescheduling itself
+    * if there is more work left.
+    */
+    void checkPendingBlocksWhileIdle();
+
+    /*
+    * Restarts the idle timer if any blocks are pending.
+    */
+    void scheduleIdleCheck();
+
+    /*
+    * Starts computing suggestions in the background for the misspelled
+    * words in view.
+    */
+    void prefetchVisibleSuggestions();
 };
 
 SpellCheckDecorator::SpellCheckDecorator(QPlainTextEdit *editor)
@@ -85,6 +295,41 @@ SpellCheckDecorator::SpellCheckDecorator(QPlainTextEdit *editor)
     d->editor->installEventFilter(this);
     d->editor->viewport()->installEventFilter(this);
 
+    for (int i = 0; i < d->editor->document()->blockCount(); i++) {
+        d->blockStates.append(d->createBlockState(false));
+    }
+
+    d->idleTimer = new QTimer(this);
+    d->idleTimer->setSingleShot(true);
+
+    connect(d->idleTimer,
+        &QTimer::timeout,
+        this,
+        [d]() {
+            d->checkPendingBlocksWhileIdle();
+        }
+    );
+
+    d->prefetchTimer = new QTimer(this);
+    d->prefetchTimer->setSingleShot(true);
+    d->prefetchTimer->setInterval(GW_SPELL_CHECK_PREFETCH_DELAY);
+
+    connect(d->prefetchTimer,
+        &QTimer::timeout,
+        this,
+        [d]() {
+            d->prefetchVisibleSuggestions();
+        }
+    );
+
+    connect(d->editor->verticalScrollBar(),
+        &QScrollBar::valueChanged,
+        this,
+        [d]() {
+            d->checkVisibleBlocks();
+        }
+    );
+
     connect(d->editor->document(),
         static_cast<void (QTextDocument::*)(int, int, int)>(&QTextDocument::contentsChange),
         this,
@@ -92,6 +337,33 @@ SpellCheckDecorator::SpellCheckDecorator(QPlainTextEdit *editor)
             d->onContentsChanged(position, charsAdded, charsRemoved);
         }
     );
+
+    // Blocks are not tracked one change at a time while a file is loading,
+    // but all at once when it is done.
+    MarkdownDocument *markdownDocument =
+        qobject_cast<MarkdownDocument *>(d->editor->document());
+
+    if (nullptr != markdownDocument) {
+        connect(markdownDocument,
+            &MarkdownDocument::loadingFinished,
+            this,
+            [d]() {
+                if (d->spellCheckEnabled) {
+                    d->markAllBlocksPending();
+                }
+            }
+        );
+    }
+
+    // Dictionaries are loaded in the background, so pick up the real one
+    // once it is ready.
+    connect(DictionaryManager::instance(),
+        &DictionaryManager::changed,
+        this,
+        [d]() {
+            d->updateDictionary();
+        }
+    );
 }
 
 SpellCheckDecorator::~SpellCheckDecorator()
@@ -113,6 +385,49 @@ QColor SpellCheckDecorator::errorColor() const
     return d->errorColor;
 }
 
+SpellCheckDecorator::Results SpellCheckDecorator::results() const
+{
+    Q_D(const SpellCheckDecorator);
+
+    Results results;
+    results.language = d->language;
+
+    if (!d->spellCheckEnabled) {
+        return results;
+    }
+
+    results.checked.reserve(d->blockStates.size());
+    results.misspelledWords.reserve(d->blockStates.size());
+
+    for (const SpellCheckDecoratorPrivate::BlockState &state : d->blockStates) {
+        results.checked.append(!state.pending);
+        results.misspelledWords.append(d->blockMisspellings.value(state.id));
+    }
+
+    return results;
+}
+
+void SpellCheckDecorator::restoreResults(const Results &results)
+{
+    Q_D(SpellCheckDecorator);
+
+    if (!d->spellCheckEnabled
+            || (results.language != d->language)
+            || (results.checked.size() != d->blockStates.size())
+            || (d->blockStates.size() != d->editor->document()->blockCount())) {
+        return;
+    }
+
+    QTextBlock block = d->editor->document()->begin();
+
+    for (int i = 0; i < results.checked.size(); i++, block = block.next()) {
+        if (results.checked[i] && results.misspelledWords[i].isEmpty()) {
+            d->setBlockPending(i, false);
+            d->blockStates[i].structure = d->blockStructure(block);
+        }
+    }
+}
+
 void SpellCheckDecorator::setLiveSpellCheckEnabled(bool enabled)
 {
     Q_D(SpellCheckDecorator);
@@ -127,7 +442,8 @@ void SpellCheckDecorator::setDictionary(const QString &language)
 {
     Q_D(SpellCheckDecorator);
 
-    d->dictionary = DictionaryManager::instance()->requestDictionary(language);
+    d->language = language;
+    d->updateDictionary();
 }
 
 void SpellCheckDecorator::setErrorColor(const QColor &color)
@@ -157,18 +473,18 @@ void SpellCheckDecorator::startLiveSpellCheck()
         return;
     }
 
-    QTextBlock block = d->editor->document()->begin();
-
-    while (block.isValid()) {
-        d->spellCheckBlock(block);
-        block = block.next();
-    }
+    d->markAllBlocksPending();
 }
 
 bool SpellCheckDecorator::eventFilter(QObject *watched, QEvent *event)
 {
     Q_D(SpellCheckDecorator);
-    Q_UNUSED(watched);
+
+    if ((QEvent::Resize == event->type())
+            && (d->editor->viewport() == watched)) {
+        d->checkVisibleBlocks();
+        return false;
+    }
 
     if ((event->type() != QEvent::ContextMenu)
             || !d->spellCheckEnabled
@@ -256,12 +572,12 @@ QMenu * SpellCheckDecoratorPrivate::createContextMenu(
 
 QMenu * SpellCheckDecoratorPrivate::createSpellingMenu(
     const QString &misspelledWord,
-    const QTextCursor &cursorForWord) const
+    const QTextCursor &cursorForWord)
 {
-    Q_Q(const SpellCheckDecorator);
+    Q_Q(SpellCheckDecorator);
 
     QMenu *spellingMenu = new QMenu(q->tr("Spelling"));
-    QStringList suggestions = this->dictionary->suggestions(misspelledWord);
+    QStringList suggestions = suggestionCache.suggestions(dictionary, misspelledWord);
 
     QAction *addWordToDictionaryAction =
         new QAction(q->tr("Add word to dictionary"), spellingMenu);
@@ -273,11 +589,26 @@ QMenu * SpellCheckDecoratorPrivate::createSpellingMenu(
             this->editor->setTextCursor(cursorForWord);
             this->dictionary->addToPersonal(misspelledWord);
 
-            resetLiveSpellChecking();
+            markBlocksPendingForWord(misspelledWord);
+        }
+    );
+
+    QAction *ignoreWordAction =
+        new QAction(q->tr("Ignore word"), spellingMenu);
+
+    q->connect(ignoreWordAction,
+        &QAction::triggered,
+        q,
+        [this, cursorForWord, misspelledWord]() {
+            this->editor->setTextCursor(cursorForWord);
+            this->dictionary->addToSession(QStringList(misspelledWord));
+
+            markBlocksPendingForWord(misspelledWord);
         }
     );
 
     spellingMenu->addAction(addWordToDictionaryAction);
+    spellingMenu->addAction(ignoreWordAction);
     spellingMenu->addSeparator();
 
     if (!suggestions.empty()) {
@@ -363,86 +694,660 @@ void SpellCheckDecoratorPrivate::onContentsChanged(
     int charsAdded,
     int charsRemoved)
 {
-    if (!this->spellCheckEnabled) {
+    Q_UNUSED(charsRemoved)
+
+    QTextDocument *document = editor->document();
+    MarkdownDocument *markdownDocument = qobject_cast<MarkdownDocument *>(document);
+
+    if (!this->spellCheckEnabled
+            || ((nullptr != markdownDocument) && markdownDocument->isLoading())) {
         return;
     }
 
-    QTextBlock firstBlock = editor->document()->findBlock(position);
-    QTextBlock lastBlock = editor->document()->findBlock(position
-                            + charsAdded + charsRemoved);
+    // Keep the dictionary free for checking the text being typed.
+    suggestionCache.cancelPrefetch();
+
+    QTextBlock firstBlock = document->findBlock(position);
 
     if (!firstBlock.isValid()) {
         return;
     }
 
-    QTextBlock block = firstBlock;
-    int endPosition;
+    // Keep the pending flags aligned with the block numbers.  Any blocks
+    // that were inserted or removed by this change directly follow the
+    // first changed block.
+    int firstBlockNumber = firstBlock.blockNumber();
+    int delta = document->blockCount() - blockStates.size();
+
+    if (delta > 0) {
+        int insertAt = qMin(firstBlockNumber + 1, blockStates.size());
+        blockStates.insert(insertAt, delta, BlockState());
+
+        for (int i = insertAt; i < (insertAt + delta); i++) {
+            blockStates[i] = createBlockState(true);
+        }
+
+        pendingCount += delta;
+    } else if (delta < 0) {
+        int removeAt = qMin(firstBlockNumber + 1, blockStates.size());
+        int removeCount = qMin(-delta, blockStates.size() - removeAt);
+
+        for (int i = removeAt; i < (removeAt + removeCount); i++) {
+            if (blockStates[i].pending) {
+                pendingCount--;
+            }
 
-    if (lastBlock.isValid()) {
-        endPosition = lastBlock.position() + lastBlock.length();
+            forgetMisspellings(blockStates[i].id);
+        }
+
+        blockStates.remove(removeAt, removeCount);
     }
-    else {
-        endPosition = editor->document()->characterCount() - 1;
+
+    QTextBlock lastBlock = document->findBlock(position + charsAdded);
+
+    if (!lastBlock.isValid()) {
+        lastBlock = document->lastBlock();
     }
 
-    while (block.isValid() && (block.position() < endPosition)) {
-        spellCheckBlock(block);
-        block = block.next();
+    for (QTextBlock block = firstBlock;
+            block.isValid() && (block.blockNumber() <= lastBlock.blockNumber());
+            block = block.next()) {
+        int blockNumber = block.blockNumber();
+
+        setBlockPending(blockNumber, true);
+
+        if (blockNumber < blockStates.size()) {
+            blockStates[blockNumber].structure = blockStructure(block);
+        }
     }
+
+    markFollowingBlocksPending(lastBlock.blockNumber());
+
+    // Only the changed blocks in view are checked now.  Pasting or loading
+    // a large amount of text thus costs about one screenful of checking.
+    checkVisibleBlocks();
+    scheduleIdleCheck();
 }
 
-void SpellCheckDecoratorPrivate::spellCheckBlock(QTextBlock &block) const
+QStringList SpellCheckDecoratorPrivate::spellCheckBlock(QTextBlock &block) const
 {
-    QStringRef misspelledWord = dictionary->check(block.text(), 0);
+    QStringList misspelledWords;
+    QString text = spellCheckableText(block);
+    QVector<QStringRef> misspellings;
 
-    while (!misspelledWord.isNull()) {
-        int startIndex = misspelledWord.position();
-        int length = misspelledWord.length();
+    if (!text.isNull()) {
+        misspellings = dictionary->checkAll(text);
+    }
+
+    const QVector<QTextLayout::FormatRange> oldFormats = block.layout()->formats();
+
+    // Build the block's complete list of formats, replacing any prior
+    // spelling errors, so that the layout is only updated once.
+    QVector<QTextLayout::FormatRange> formats;
+    formats.reserve(oldFormats.size() + misspellings.size());
+
+    for (const QTextLayout::FormatRange &format : oldFormats) {
+        if (QTextCharFormat::SpellCheckUnderline != format.format.underlineStyle()) {
+            formats.append(format);
+        }
+    }
+
+    if (misspellings.isEmpty() && (formats.size() == oldFormats.size())) {
+        return misspelledWords;
+    }
 
-        QTextCharFormat spellingErrorFormat;
-        spellingErrorFormat.setUnderlineColor(Qt::red);
-        spellingErrorFormat.setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
+    QTextCharFormat spellingErrorFormat;
+    spellingErrorFormat.setUnderlineColor(Qt::red);
+    spellingErrorFormat.setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
 
+    for (const QStringRef &misspelledWord : misspellings) {
         QTextLayout::FormatRange range;
-        range.start = startIndex;
-        range.length = length;
+        range.start = misspelledWord.position();
+        range.length = misspelledWord.length();
         range.format = spellingErrorFormat;
 
-        auto formats = block.layout()->formats();
         formats.append(range);
-        block.layout()->setFormats(formats);
+        misspelledWords.append(misspelledWord.toString().toLower());
+    }
+
+    block.layout()->setFormats(formats);
+
+    misspelledWords.removeDuplicates();
+    return misspelledWords;
+}
+
+QString SpellCheckDecoratorPrivate::spellCheckableText(const QTextBlock &block) const
+{
+    QString text = block.text();
+    MarkdownDocument *document = qobject_cast<MarkdownDocument *>(editor->document());
+
+    if ((nullptr == document) || (nullptr == document->markdownAST())) {
+        return text;
+    }
+
+    int lineNumber = block.blockNumber() + 1;
+    MarkdownNode *node = document->markdownAST()->findBlockAtLine(lineNumber);
+
+    // Lines outside of any node, such as link reference definitions,
+    // may still hold URLs.
+    bool hasCode = false;
+    bool hasHtml = false;
+    bool hasLinks = (nullptr == node);
+
+    // The source positions cmark-gfm reports for inline nodes are not
+    // reliable enough to cut out their text directly, so the AST is only
+    // used to find out which constructs are on this line.  They are then
+    // located by their delimiters in the block text.
+    QVector<MarkdownNode *> nodes;
+
+    if (nullptr != node) {
+        nodes.append(node);
+    }
+
+    while (!nodes.isEmpty()) {
+        node = nodes.takeLast();
+
+        if ((node->startLine() > lineNumber)
+                || ((0 != node->endLine()) && (node->endLine() < lineNumber))) {
+            continue;
+        }
+
+        switch (node->type()) {
+        case MarkdownNode::CodeBlock:
+        case MarkdownNode::HtmlBlock:
+            return QString();
+        case MarkdownNode::Code:
+            hasCode = true;
+            continue;
+        case MarkdownNode::HtmlInline:
+            hasHtml = true;
+            continue;
+        case MarkdownNode::Link:
+        case MarkdownNode::Image:
+            hasLinks = true;
+            break;
+        default:
+            break;
+        }
+
+        for (MarkdownNode *child = node->firstChild();
+                nullptr != child;
+                child = child->next()) {
+            nodes.append(child);
+        }
+    }
+
+    if (hasCode) {
+        maskCodeSpans(text);
+    }
 
-        startIndex += length;
-        misspelledWord = dictionary->check(block.text(), startIndex);
+    if (hasHtml) {
+        maskMatches(text, htmlTagRegex);
+    }
+
+    if (hasLinks) {
+        maskMatches(text, linkDestinationRegex, 1);
+        maskMatches(text, htmlTagRegex);
+    }
+
+    // Bare URLs and e-mail addresses are not necessarily parsed as links,
+    // but are never prose.
+    maskMatches(text, urlRegex);
+
+    return text;
+}
+
+int SpellCheckDecoratorPrivate::blockStructure(const QTextBlock &block) const
+{
+    MarkdownDocument *document = qobject_cast<MarkdownDocument *>(editor->document());
+
+    if ((nullptr == document) || (nullptr == document->markdownAST())) {
+        return 0;
+    }
+
+    int lineNumber = block.blockNumber() + 1;
+    MarkdownNode *node = document->markdownAST()->findBlockAtLine(lineNumber);
+
+    // Descend through the containers, such as lists and block quotes, that
+    // hold the line.
+    while (nullptr != node) {
+        if ((MarkdownNode::CodeBlock == node->type())
+                || (MarkdownNode::HtmlBlock == node->type())) {
+            if (0 == node->endLine()) {
+                return GW_BLOCK_STRUCTURE_OPEN_ENDED;
+            }
+
+            return node->endLine() - lineNumber + 1;
+        }
+
+        MarkdownNode *child = node->firstChild();
+
+        while ((nullptr != child)
+                && ((child->startLine() > lineNumber)
+                    || ((0 != child->endLine()) && (child->endLine() < lineNumber)))) {
+            child = child->next();
+        }
+
+        node = child;
+    }
+
+    return 0;
+}
+
+void SpellCheckDecoratorPrivate::maskCodeSpans(QString &text) const
+{
+    int i = 0;
+
+    while (i < text.length()) {
+        if ('`' != text[i]) {
+            i++;
+            continue;
+        }
+
+        int start = i;
+
+        while ((i < text.length()) && ('`' == text[i])) {
+            i++;
+        }
+
+        int fenceLength = i - start;
+        int end = -1;
+        int j = i;
+
+        // Find a closing run of backticks of the same length.
+        while (j < text.length()) {
+            if ('`' != text[j]) {
+                j++;
+                continue;
+            }
+
+            int runStart = j;
+
+            while ((j < text.length()) && ('`' == text[j])) {
+                j++;
+            }
+
+            if ((j - runStart) == fenceLength) {
+                end = j;
+                break;
+            }
+        }
+
+        if (end < 0) {
+            // An unmatched run of backticks is literal text.
+            continue;
+        }
+
+        for (int k = start; k < end; k++) {
+            text[k] = ' ';
+        }
+
+        i = end;
+    }
+}
+
+void SpellCheckDecoratorPrivate::maskMatches(
+    QString &text,
+    const QRegularExpression &regex,
+    int group) const
+{
+    QRegularExpressionMatchIterator iter = regex.globalMatch(text);
+
+    while (iter.hasNext()) {
+        QRegularExpressionMatch match = iter.next();
+        int end = match.capturedEnd(group);
+
+        for (int i = match.capturedStart(group); (i >= 0) && (i < end); i++) {
+            text[i] = ' ';
+        }
     }
 }
 
 void SpellCheckDecoratorPrivate::clearSpellCheckFormatting(QTextBlock &block) const
 {
     QVector<QTextLayout::FormatRange> formats;
+    const QVector<QTextLayout::FormatRange> oldFormats = block.layout()->formats();
 
-    for (const QTextLayout::FormatRange &format : block.layout()->formats()) {
+    for (const QTextLayout::FormatRange &format : oldFormats) {
         if (QTextCharFormat::SpellCheckUnderline != format.format.underlineStyle()) {
             formats.append(format);
         }
     }
 
-    block.layout()->setFormats(formats);
+    // Avoid needlessly invalidating the block's layout.
+    if (formats.size() != oldFormats.size()) {
+        block.layout()->setFormats(formats);
+    }
 }
 
-void SpellCheckDecoratorPrivate::resetLiveSpellChecking() const
+void SpellCheckDecoratorPrivate::resetLiveSpellChecking()
 {
+    if (spellCheckEnabled) {
+        // Pending blocks have their old formatting cleared when they are
+        // checked again.
+        markAllBlocksPending();
+        return;
+    }
+
+    idleTimer->stop();
+    pendingCount = 0;
+
+    for (BlockState &state : blockStates) {
+        state.pending = false;
+    }
+
+    clearMisspellings();
+
     QTextBlock block = editor->document()->begin();
 
     while (block.isValid()) {
         clearSpellCheckFormatting(block);
+        block = block.next();
+    }
+}
+
+void SpellCheckDecoratorPrivate::updateDictionary()
+{
+    Dictionary *newDictionary = DictionaryManager::instance()->requestDictionary(language);
+
+    if (newDictionary != dictionary) {
+        dictionary = newDictionary;
 
         if (spellCheckEnabled) {
-            spellCheckBlock(block);
+            markNonEmptyBlocksPending();
+        }
+    }
+}
+
+void SpellCheckDecoratorPrivate::markAllBlocksPending()
+{
+    int blockCount = editor->document()->blockCount();
+
+    clearMisspellings();
+    blockStates.clear();
+    blockStates.reserve(blockCount);
+
+    for (int i = 0; i < blockCount; i++) {
+        blockStates.append(createBlockState(true));
+    }
+
+    pendingCount = blockCount;
+    idleScanIndex = 0;
+
+    checkVisibleBlocks();
+    scheduleIdleCheck();
+}
+
+void SpellCheckDecoratorPrivate::markNonEmptyBlocksPending()
+{
+    if (blockStates.size() != editor->document()->blockCount()) {
+        markAllBlocksPending();
+        return;
+    }
+
+    QTextBlock block = editor->document()->begin();
+
+    while (block.isValid()) {
+        // The block length includes the paragraph separator.
+        if (block.length() > 1) {
+            setBlockPending(block.blockNumber(), true);
+        }
+
+        block = block.next();
+    }
+
+    idleScanIndex = 0;
+
+    checkVisibleBlocks();
+    scheduleIdleCheck();
+}
+
+void SpellCheckDecoratorPrivate::markBlocksPendingForWord(const QString &word)
+{
+    QSet<quint32> blockIds = misspelledWordIndex.value(word.toLower());
+
+    if (blockIds.isEmpty()) {
+        return;
+    }
+
+    for (int i = 0; i < blockStates.size(); i++) {
+        if (blockIds.contains(blockStates[i].id)) {
+            setBlockPending(i, true);
+        }
+    }
+
+    checkVisibleBlocks();
+    scheduleIdleCheck();
+}
+
+void SpellCheckDecoratorPrivate::markFollowingBlocksPending(int blockNumber)
+{
+    QTextBlock block = editor->document()->findBlockByNumber(blockNumber);
+
+    if (block.isValid()) {
+        block = block.next();
+    }
+
+    // Past the first block whose structure is unchanged, the blocks are
+    // parsed the same as before the edit.
+    while (block.isValid() && (block.blockNumber() < blockStates.size())) {
+        BlockState &state = blockStates[block.blockNumber()];
+        int structure = blockStructure(block);
+
+        if (structure == state.structure) {
+            break;
+        }
+
+        state.structure = structure;
+
+        if (block.length() > 1) {
+            setBlockPending(block.blockNumber(), true);
+        }
+
+        block = block.next();
+    }
+}
+
+void SpellCheckDecoratorPrivate::setBlockPending(int blockNumber, bool pending)
+{
+    if ((blockNumber < 0) || (blockNumber >= blockStates.size())) {
+        return;
+    }
+
+    BlockState &state = blockStates[blockNumber];
+
+    if (state.pending != pending) {
+        state.pending = pending;
+        pendingCount += pending ? 1 : -1;
+    }
+}
+
+SpellCheckDecoratorPrivate::BlockState
+SpellCheckDecoratorPrivate::createBlockState(bool pending)
+{
+    BlockState state;
+    state.pending = pending;
+    state.id = nextBlockId++;
+    state.structure = GW_BLOCK_STRUCTURE_UNKNOWN;
+    return state;
+}
+
+void SpellCheckDecoratorPrivate::forgetMisspellings(quint32 blockId)
+{
+    const QStringList words = blockMisspellings.take(blockId);
+
+    for (const QString &word : words) {
+        auto iter = misspelledWordIndex.find(word);
+
+        if (iter != misspelledWordIndex.end()) {
+            iter->remove(blockId);
+
+            if (iter->isEmpty()) {
+                misspelledWordIndex.erase(iter);
+            }
+        }
+    }
+}
+
+void SpellCheckDecoratorPrivate::clearMisspellings()
+{
+    misspelledWordIndex.clear();
+    blockMisspellings.clear();
+}
+
+void SpellCheckDecoratorPrivate::checkPendingBlock(QTextBlock &block)
+{
+    int blockNumber = block.blockNumber();
+
+    if ((blockNumber < 0)
+            || (blockNumber >= blockStates.size())
+            || !blockStates[blockNumber].pending) {
+        return;
+    }
+
+    setBlockPending(blockNumber, false);
+    blockStates[blockNumber].structure = blockStructure(block);
+
+    quint32 blockId = blockStates[blockNumber].id;
+    forgetMisspellings(blockId);
+
+    QStringList misspelledWords = spellCheckBlock(block);
+
+    if (!misspelledWords.isEmpty()) {
+        for (const QString &word : misspelledWords) {
+            misspelledWordIndex[word].insert(blockId);
+        }
+
+        blockMisspellings.insert(blockId, misspelledWords);
+    }
+}
+
+void SpellCheckDecoratorPrivate::checkVisibleBlocks()
+{
+    if (spellCheckEnabled) {
+        prefetchTimer->start();
+    }
+
+    if (!spellCheckEnabled || (pendingCount <= 0)) {
+        return;
+    }
+
+    QRect viewportRect = editor->viewport()->rect();
+    QTextBlock block = editor->cursorForPosition(viewportRect.topLeft()).block();
+    QTextBlock lastBlock = editor->cursorForPosition(viewportRect.bottomRight()).block();
+
+    if (!block.isValid() || !lastBlock.isValid()) {
+        return;
+    }
+
+    for (int i = 0; (i < GW_SPELL_CHECK_VIEWPORT_MARGIN) && block.previous().isValid(); i++) {
+        block = block.previous();
+    }
+
+    for (int i = 0; (i < GW_SPELL_CHECK_VIEWPORT_MARGIN) && lastBlock.next().isValid(); i++) {
+        lastBlock = lastBlock.next();
+    }
+
+    int lastBlockNumber = lastBlock.blockNumber();
+
+    while (block.isValid() && (block.blockNumber() <= lastBlockNumber)) {
+        checkPendingBlock(block);
+        block = block.next();
+    }
+}
+
+void SpellCheckDecoratorPrivate::checkPendingBlocksWhileIdle()
+{
+    if (!spellCheckEnabled || (pendingCount <= 0)) {
+        return;
+    }
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    if ((idleScanIndex < 0) || (idleScanIndex >= blockStates.size())) {
+        idleScanIndex = 0;
+    }
+
+    // Find the first pending block, starting from where the last time
+    // slice left off and wrapping around to the top of the document.
+    int scanned = 0;
+
+    while ((scanned < blockStates.size()) && !blockStates[idleScanIndex].pending) {
+        idleScanIndex = (idleScanIndex + 1) % blockStates.size();
+        scanned++;
+    }
+
+    if (scanned >= blockStates.size()) {
+        pendingCount = 0;
+        return;
+    }
+
+    QTextBlock block = editor->document()->findBlockByNumber(idleScanIndex);
+
+    while ((pendingCount > 0)
+            && block.isValid()
+            && (elapsed.elapsed() < GW_SPELL_CHECK_IDLE_SLICE)) {
+        checkPendingBlock(block);
+        block = block.next();
+
+        if (!block.isValid()) {
+            block = editor->document()->begin();
+        }
+    }
+
+    idleScanIndex = block.isValid() ? block.blockNumber() : 0;
+
+    if (pendingCount > 0) {
+        // Yield to the event loop, but pick up where we left off as soon
+        // as any user input has been processed.
+        idleTimer->start(0);
+    }
+}
+
+void SpellCheckDecoratorPrivate::scheduleIdleCheck()
+{
+    if (spellCheckEnabled && (pendingCount > 0)) {
+        idleTimer->start(GW_SPELL_CHECK_IDLE_DELAY);
+    }
+}
+
+void SpellCheckDecoratorPrivate::prefetchVisibleSuggestions()
+{
+    if (!spellCheckEnabled) {
+        return;
+    }
+
+    QRect viewportRect = editor->viewport()->rect();
+    QTextBlock block = editor->cursorForPosition(viewportRect.topLeft()).block();
+    QTextBlock lastBlock = editor->cursorForPosition(viewportRect.bottomRight()).block();
+
+    if (!block.isValid() || !lastBlock.isValid()) {
+        return;
+    }
+
+    QStringList words;
+    int lastBlockNumber = lastBlock.blockNumber();
+
+    while (block.isValid()
+            && (block.blockNumber() <= lastBlockNumber)
+            && (words.size() < GW_SPELL_CHECK_PREFETCH_LIMIT)) {
+        QString text = block.text();
+
+        for (const QTextLayout::FormatRange &range : block.layout()->formats()) {
+            if (QTextCharFormat::SpellCheckUnderline == range.format.underlineStyle()) {
+                QString word = text.mid(range.start, range.length);
+
+                if (!words.contains(word)) {
+                    words.append(word);
+                }
+            }
         }
 
         block = block.next();
     }
+
+    suggestionCache.prefetch(dictionary, words);
 }
 
 } // namespace ghostwriter
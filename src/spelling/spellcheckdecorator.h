@@ -24,6 +24,9 @@
 #include <QObject>
 #include <QPlainTextEdit>
 #include <QScopedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
 
 namespace ghostwriter
 {
@@ -44,6 +47,29 @@ class SpellCheckDecorator : public QObject
     Q_DECLARE_PRIVATE(SpellCheckDecorator)
 
 public:
+    /**
+     * Live spell check results for each block of the document, which can
+     * be kept when the document is closed and restored when the same
+     * text is loaded again.
+     */
+    struct Results
+    {
+        /**
+         * Language of the dictionary the blocks were checked with.
+         */
+        QString language;
+
+        /**
+         * Whether each block has been checked.
+         */
+        QVector<bool> checked;
+
+        /**
+         * Misspelled words found in each checked block, in lower case.
+         */
+        QVector<QStringList> misspelledWords;
+    };
+
     /**
      * Constructor.
      */
@@ -64,6 +90,21 @@ public:
      */
     QColor errorColor() const;
 
+    /**
+     * Returns the live spell check results for the document so far.  The
+     * results are empty if live spell checking is disabled.
+     */
+    Results results() const;
+
+    /**
+     * Restores the results for the document's text, as returned by
+     * results() for the same text.  Blocks that were found free of errors
+     * are not checked again.  Blocks with errors are, since their error
+     * formatting did not survive.  Results that do not match the blocks
+     * or the dictionary language of the document are ignored.
+     */
+    void restoreResults(const Results &results);
+
 public slots:
     /**
      * Sets whether live spell checking is enabled.
@@ -93,6 +134,9 @@ public slots:
      * live spell check highlighting, as it tends to rehighlight from scratch
      * multiple times during initialization / first load of text in the document.
      *
+     * Only the blocks in view are checked right away.  The remaining blocks
+     * are checked as they are scrolled into view or while the editor is idle.
+     *
      * Note: If live spell checking is disabled (with a call to
      * setLiveSpellCheckEnabled(false), this method will do nothing.
      */
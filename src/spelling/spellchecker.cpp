@@ -23,7 +23,9 @@
 #include <QAction>
 #include <QDialogButtonBox>
 #include <QDir>
+#include <QEventLoop>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QGridLayout>
 #include <QLabel>
 #include <QLineEdit>
@@ -34,6 +36,12 @@
 #include <QPushButton>
 #include <QTextBlock>
 #include <QTextLayout>
+#include <QtConcurrentMap>
+
+// Number of blocks scanned together by one worker thread.  Small enough
+// for the work to balance out across cores and for the progress bar to
+// move smoothly, large enough to keep the per-chunk overhead negligible.
+#define GW_SPELL_CHECK_SCAN_CHUNK_SIZE 256
 
 namespace ghostwriter
 {
@@ -46,6 +54,29 @@ void SpellChecker::checkDocument(QPlainTextEdit *document, Dictionary *dictionar
 	checker->m_cursor.movePosition(QTextCursor::StartOfBlock);
 	checker->m_loopAvailable = checker->m_startCursor.block().previous().isValid();
 	checker->show();
+
+	if (!checker->scan()) {
+		checker->reject();
+		return;
+	}
+
+	// Start with the first misspelling at or after the start cursor.
+	int startPosition = checker->m_cursor.position();
+	int index = 0;
+
+	while ((index < checker->m_misspellings.size())
+			&& (checker->m_misspellings[index].position < startPosition)) {
+		index++;
+	}
+
+	checker->m_nextIndex = index;
+	checker->m_stopIndex = index;
+
+	// Keep the misspelling positions in step with the changes made from
+	// the dialog.
+	connect(document->document(), &QTextDocument::contentsChange,
+		checker, &SpellChecker::onContentsChange);
+
     checker->check();
 }
 
@@ -104,13 +135,33 @@ void SpellChecker::changeAll()
 	check();
 }
 
+void SpellChecker::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+	int delta = charsAdded - charsRemoved;
+
+	for (Misspelling &misspelling : m_misspellings) {
+		if ((misspelling.position < 0)
+				|| ((misspelling.position + misspelling.length) <= position)) {
+			continue;
+		}
+
+		if (misspelling.position >= (position + charsRemoved)) {
+			misspelling.position += delta;
+		} else {
+			// The word itself was changed.
+			misspelling.position = -1;
+		}
+	}
+}
+
 SpellChecker::SpellChecker(QPlainTextEdit *document, Dictionary *dictionary) :
 	QDialog(document->parentWidget(), Qt::WindowTitleHint | Qt::WindowSystemMenuHint | Qt::WindowCloseButtonHint),
 	m_dictionary(dictionary),
     m_document(document),
-	m_checkedBlocks(1),
-	m_totalBlocks(document->document()->blockCount()),
-	m_loopAvailable(true)
+	m_nextIndex(0),
+	m_stopIndex(0),
+	m_loopAvailable(true),
+	m_wrapped(false)
 {
 	setWindowTitle(tr("Check Spelling"));
 	setWindowModality(Qt::WindowModal);
@@ -171,60 +222,129 @@ SpellChecker::SpellChecker(QPlainTextEdit *document, Dictionary *dictionary) :
 	layout->addWidget(buttons, 8, 3);
 }
 
-void SpellChecker::check()
+bool SpellChecker::scan()
 {
 	setDisabled(true);
 
-	QProgressDialog waitDialog(tr("Checking spelling..."), tr("Cancel"), 0, m_totalBlocks, this);
+	// Take a snapshot of the document text so that the workers never
+	// touch the QTextDocument.
+	QVector<ScanChunk> chunks;
+
+	for (QTextBlock block = m_document->document()->begin(); block.isValid(); block = block.next()) {
+		if (chunks.isEmpty() || (chunks.last().blockTexts.size() >= GW_SPELL_CHECK_SCAN_CHUNK_SIZE)) {
+			chunks.append(ScanChunk());
+			chunks.last().dictionary = m_dictionary;
+		}
+
+		chunks.last().blockTexts.append(block.text());
+		chunks.last().blockPositions.append(block.position());
+	}
+
+	QProgressDialog waitDialog(tr("Checking spelling..."), tr("Cancel"), 0, chunks.size(), this);
 	waitDialog.setWindowTitle(tr("Please wait"));
 	waitDialog.setValue(0);
 	waitDialog.setWindowModality(Qt::WindowModal);
-	bool canceled = false;
 
+	QFutureWatcher<QVector<Misspelling>> watcher;
+	QEventLoop loop;
+
+	connect(&watcher, &QFutureWatcherBase::progressValueChanged, &waitDialog, &QProgressDialog::setValue);
+	connect(&watcher, &QFutureWatcherBase::finished, &loop, &QEventLoop::quit);
+	connect(&waitDialog, &QProgressDialog::canceled, &watcher, &QFutureWatcherBase::cancel);
+
+	// Dictionaries that cannot be used from several threads at once scan
+	// the chunks one after the other on this thread instead.
+	if (!m_dictionary->isThreadSafe()) {
+		QVector<Misspelling> misspellings;
+
+		for (int i = 0; i < chunks.size(); i++) {
+			if (waitDialog.wasCanceled()) {
+				waitDialog.close();
+				return false;
+			}
+
+			misspellings += scanChunk(chunks[i]);
+			waitDialog.setValue(i + 1);
+		}
+
+		waitDialog.close();
+		m_misspellings = misspellings;
+		return true;
+	}
+
+	watcher.setFuture(QtConcurrent::mapped(chunks, &SpellChecker::scanChunk));
+	loop.exec();
+
+	bool canceled = watcher.isCanceled();
+	waitDialog.close();
+
+	if (canceled) {
+		return false;
+	}
+
+	m_misspellings.clear();
+
+	for (int i = 0; i < chunks.size(); i++) {
+		m_misspellings += watcher.future().resultAt(i);
+	}
+
+	return true;
+}
+
+QVector<SpellChecker::Misspelling> SpellChecker::scanChunk(const ScanChunk &chunk)
+{
+	QVector<Misspelling> misspellings;
+
+	for (int i = 0; i < chunk.blockTexts.size(); i++) {
+		const QVector<QStringRef> words = chunk.dictionary->checkAll(chunk.blockTexts[i]);
+
+		for (const QStringRef &word : words) {
+			misspellings.append({ chunk.blockPositions[i] + word.position(), word.length() });
+		}
+	}
+
+	return misspellings;
+}
+
+void SpellChecker::check()
+{
 	forever {
-		// Update wait dialog
-		waitDialog.setValue(m_checkedBlocks);
-		if (waitDialog.wasCanceled()) {
-			canceled = true;
+		if (m_wrapped && (m_nextIndex >= m_stopIndex)) {
+			// Back where the check started.
 			break;
 		}
 
-		// Check current line
-		QTextBlock block = m_cursor.block();
-		QStringRef word =  m_dictionary->check(block.text(), m_cursor.position() - block.position());
-		if (word.isNull()) {
-			if (block.next().isValid()) {
-                m_cursor.movePosition(QTextCursor::NextBlock);
-				++m_checkedBlocks;
-				if (m_checkedBlocks < m_totalBlocks) {
-					continue;
-				} else {
-					break;
-				}
-			} else if (m_loopAvailable) {
-				waitDialog.reset();
+		if (m_nextIndex >= m_misspellings.size()) {
+			// Only offer to continue if there is anything left to check.
+			if (m_loopAvailable && (m_stopIndex > 0)) {
 				if (QMessageBox::question(this, QString(), tr("Continue checking at beginning of file?"),
 						QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes) == QMessageBox::Yes) {
 					m_loopAvailable = false;
-                    m_cursor.movePosition(QTextCursor::Start);
-					waitDialog.setRange(0, m_totalBlocks);
+					m_wrapped = true;
+					m_nextIndex = 0;
 					continue;
 				} else {
-					canceled = true;
-					break;
+					reject();
+					return;
 				}
-			} else {
-				break;
 			}
+
+			break;
+		}
+
+		Misspelling misspelling = m_misspellings[m_nextIndex++];
+
+		if (misspelling.position < 0) {
+			continue;
 		}
 
 		// Select misspelled word
-		m_cursor.setPosition(word.position() + block.position());
-		m_cursor.setPosition(m_cursor.position() + word.length(), QTextCursor::KeepAnchor);
+		m_cursor.setPosition(misspelling.position);
+		m_cursor.setPosition(misspelling.position + misspelling.length, QTextCursor::KeepAnchor);
 		m_word = m_cursor.selectedText();
 
-		if (!m_ignored.contains(m_word)) {
-			waitDialog.close();
+		// The word may have been added to the dictionary since the scan.
+		if (!m_ignored.contains(m_word) && !m_dictionary->check(m_word, 0).isNull()) {
 			setEnabled(true);
 
             // Show misspelled word in context
@@ -278,11 +398,8 @@ void SpellChecker::check()
 	}
 
 	// Inform user of completed spell check
-	waitDialog.close();
-
-	if (!canceled) {
-		QMessageBox::information(this, QString(), tr("Spell check complete."));
-	}
+	setEnabled(true);
+	QMessageBox::information(this, QString(), tr("Spell check complete."));
 
 	reject();
 }
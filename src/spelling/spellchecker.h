@@ -29,6 +29,7 @@
 #include <QPlainTextEdit>
 #include <QSyntaxHighlighter>
 #include <QTextCursor>
+#include <QVector>
 
 #include "dictionary.h"
 
@@ -52,8 +53,39 @@ private slots:
 	void change();
 	void changeAll();
 
+	void onContentsChange(int position, int charsRemoved, int charsAdded);
+
 private:
+	/*
+	* Location of a misspelled word in the document.  A negative position
+	* means the word was overwritten by an edit.
+	*/
+	struct Misspelling
+	{
+		int position;
+		int length;
+	};
+
+	/*
+	* Consecutive run of blocks to be scanned by a worker thread.
+	*/
+	struct ScanChunk
+	{
+		Dictionary *dictionary;
+		QStringList blockTexts;
+		QVector<int> blockPositions;
+	};
+
     SpellChecker(QPlainTextEdit *document, Dictionary *dictionary);
+
+	/*
+	* Scans the whole document for misspelled words, spreading the work
+	* over the global thread pool.  Returns false if the user canceled
+	* the scan.
+	*/
+	bool scan();
+	static QVector<Misspelling> scanChunk(const ScanChunk &chunk);
+
 	void check();
 
 private:
@@ -66,9 +98,14 @@ private:
 	QTextCursor m_cursor;
 	QTextCursor m_startCursor;
 
-	int m_checkedBlocks;
-	int m_totalBlocks;
+	// Misspellings found by the scan, in document order.  The dialog steps
+	// from the one at the start cursor to the end of the document, then
+	// optionally from the beginning of the document back to it.
+	QVector<Misspelling> m_misspellings;
+	int m_nextIndex;
+	int m_stopIndex;
 	bool m_loopAvailable;
+	bool m_wrapped;
 
 	QString m_word;
 	QStringList m_ignored;
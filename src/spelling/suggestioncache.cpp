@@ -0,0 +1,197 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+
+#include <QCache>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtConcurrentRun>
+
+#include "suggestioncache.h"
+
+#include "dictionary.h"
+
+namespace ghostwriter
+{
+class SuggestionCachePrivate
+{
+public:
+    typedef QPair<const Dictionary *, QString> Key;
+
+    SuggestionCachePrivate(int capacity)
+        : cache(capacity),
+          computing(false),
+          workerRunning(false)
+    {
+        // A single thread is plenty, and keeps the dictionary free for
+        // the live spell checker most of the time.
+        pool.setMaxThreadCount(1);
+    }
+
+    ~SuggestionCachePrivate()
+    {
+        ;
+    }
+
+    mutable QMutex mutex;
+    QWaitCondition computed;
+    QCache<Key, QStringList> cache;
+    QList<Key> queue;
+    Key computingKey;
+    bool computing;
+    bool workerRunning;
+    QThreadPool pool;
+
+    /*
+    * Computes the suggestions for the queued words one at a time until
+    * the queue is empty.  Runs on the thread pool.
+    */
+    void prefetchQueuedWords();
+};
+
+SuggestionCache::SuggestionCache(int capacity)
+    : d_ptr(new SuggestionCachePrivate(capacity))
+{
+    ;
+}
+
+SuggestionCache::~SuggestionCache()
+{
+    Q_D(SuggestionCache);
+
+    cancelPrefetch();
+    d->pool.waitForDone();
+}
+
+bool SuggestionCache::contains(const Dictionary *dictionary, const QString &word) const
+{
+    Q_D(const SuggestionCache);
+
+    QMutexLocker locker(&d->mutex);
+    return d->cache.contains(SuggestionCachePrivate::Key(dictionary, word));
+}
+
+QStringList SuggestionCache::suggestions(const Dictionary *dictionary, const QString &word)
+{
+    Q_D(SuggestionCache);
+
+    SuggestionCachePrivate::Key key(dictionary, word);
+
+    {
+        QMutexLocker locker(&d->mutex);
+
+        // Computing the same word twice would take longer than waiting.
+        while (d->computing && (key == d->computingKey)) {
+            d->computed.wait(&d->mutex);
+        }
+
+        QStringList *cached = d->cache.object(key);
+
+        if (nullptr != cached) {
+            return *cached;
+        }
+
+        d->queue.removeAll(key);
+    }
+
+    QStringList result = dictionary->suggestions(word);
+
+    QMutexLocker locker(&d->mutex);
+    d->cache.insert(key, new QStringList(result));
+    return result;
+}
+
+void SuggestionCache::prefetch(const Dictionary *dictionary, const QStringList &words)
+{
+    Q_D(SuggestionCache);
+
+    QMutexLocker locker(&d->mutex);
+    d->queue.clear();
+
+    // Suggestions are then only made on demand, on the calling thread.
+    if (!dictionary->isThreadSafe()) {
+        return;
+    }
+
+    for (const QString &word : words) {
+        SuggestionCachePrivate::Key key(dictionary, word);
+
+        if (!d->cache.contains(key) && !d->queue.contains(key)) {
+            d->queue.append(key);
+        }
+    }
+
+    if (!d->queue.isEmpty() && !d->workerRunning) {
+        d->workerRunning = true;
+        QtConcurrent::run(&d->pool, [d]() { d->prefetchQueuedWords(); });
+    }
+}
+
+void SuggestionCache::cancelPrefetch()
+{
+    Q_D(SuggestionCache);
+
+    QMutexLocker locker(&d->mutex);
+    d->queue.clear();
+}
+
+void SuggestionCache::clear()
+{
+    Q_D(SuggestionCache);
+
+    QMutexLocker locker(&d->mutex);
+    d->cache.clear();
+}
+
+void SuggestionCachePrivate::prefetchQueuedWords()
+{
+    forever {
+        Key key;
+
+        {
+            QMutexLocker locker(&mutex);
+
+            if (queue.isEmpty()) {
+                workerRunning = false;
+                return;
+            }
+
+            key = queue.takeFirst();
+
+            if (cache.contains(key)) {
+                continue;
+            }
+
+            computingKey = key;
+            computing = true;
+        }
+
+        QStringList result = key.first->suggestions(key.second);
+
+        QMutexLocker locker(&mutex);
+        cache.insert(key, new QStringList(result));
+        computing = false;
+        computed.wakeAll();
+    }
+}
+} // namespace ghostwriter
@@ -0,0 +1,92 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+
+#ifndef SUGGESTION_CACHE_H
+#define SUGGESTION_CACHE_H
+
+#include <QScopedPointer>
+#include <QString>
+#include <QStringList>
+
+namespace ghostwriter
+{
+class Dictionary;
+
+/**
+ * Least recently used cache of spelling suggestions, keyed by word and
+ * dictionary.  Asking Hunspell for suggestions can take hundreds of
+ * milliseconds with large dictionaries, so suggestions for the words
+ * the user is likely to right-click can be computed ahead of time on a
+ * single background thread with prefetch().
+ */
+class SuggestionCachePrivate;
+class SuggestionCache
+{
+    Q_DECLARE_PRIVATE(SuggestionCache)
+
+public:
+    /**
+     * Constructor.  Takes the maximum number of words whose suggestions
+     * are kept.
+     */
+    SuggestionCache(int capacity = 256);
+
+    /**
+     * Destructor.  Waits for any suggestions being computed in the
+     * background to finish.
+     */
+    ~SuggestionCache();
+
+    /**
+     * Returns true if the suggestions for the given word are cached.
+     */
+    bool contains(const Dictionary *dictionary, const QString &word) const;
+
+    /**
+     * Returns the suggestions for the given word from the cache.  If the
+     * word is being prefetched, waits for its result.  Otherwise, if the
+     * word is not cached, computes and caches its suggestions right away.
+     */
+    QStringList suggestions(const Dictionary *dictionary, const QString &word);
+
+    /**
+     * Computes the suggestions for the given words in the background.
+     * Replaces any words still waiting from a previous call, so that only
+     * the most recently requested words are computed.
+     */
+    void prefetch(const Dictionary *dictionary, const QStringList &words);
+
+    /**
+     * Drops any words still waiting to be prefetched.  The word currently
+     * being computed, if any, is still cached once done.
+     */
+    void cancelPrefetch();
+
+    /**
+     * Removes all cached suggestions.
+     */
+    void clear();
+
+private:
+    QScopedPointer<SuggestionCachePrivate> d_ptr;
+};
+} // namespace ghostwriter
+
+#endif // SUGGESTION_CACHE_H
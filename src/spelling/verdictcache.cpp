@@ -0,0 +1,202 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <atomic>
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include "verdictcache.h"
+
+namespace ghostwriter
+{
+class VerdictCachePrivate
+{
+public:
+    // Must be a power of two.
+    static const int ShardCount = 16;
+
+    struct Entry
+    {
+        quint32 generation;
+        bool correct;
+    };
+
+    struct Shard
+    {
+        QMutex mutex;
+        QHash<QString, Entry> entries;
+    };
+
+    VerdictCachePrivate(int capacity)
+        : generation(0), hits(0), misses(0)
+    {
+        shardCapacity = qMax(1, capacity / ShardCount);
+    }
+
+    ~VerdictCachePrivate()
+    {
+        ;
+    }
+
+    mutable Shard shards[ShardCount];
+    int shardCapacity;
+    std::atomic<quint32> generation;
+    mutable std::atomic<quint64> hits;
+    mutable std::atomic<quint64> misses;
+
+    Shard &shardFor(const QString &word) const;
+
+    /*
+    * Makes room in a full shard.  Stale entries are dropped first.  If the
+    * shard is still full afterwards, it is emptied entirely, which is far
+    * cheaper than tracking recency for every lookup and only costs a few
+    * extra dictionary calls while the common words are re-cached.
+    */
+    void evict(Shard &shard, quint32 currentGeneration);
+};
+
+VerdictCache::VerdictCache(int capacity)
+    : d_ptr(new VerdictCachePrivate(capacity))
+{
+    ;
+}
+
+VerdictCache::~VerdictCache()
+{
+    ;
+}
+
+VerdictCache::Verdict VerdictCache::lookup(const QString &word) const
+{
+    Q_D(const VerdictCache);
+
+    quint32 currentGeneration = d->generation.load(std::memory_order_acquire);
+    VerdictCachePrivate::Shard &shard = d->shardFor(word);
+    Verdict verdict = Unknown;
+
+    {
+        QMutexLocker locker(&shard.mutex);
+        auto iter = shard.entries.constFind(word);
+
+        if (iter != shard.entries.constEnd()) {
+            if (iter->generation == currentGeneration) {
+                verdict = iter->correct ? Correct : Misspelled;
+            } else {
+                shard.entries.remove(word);
+            }
+        }
+    }
+
+    if (Unknown == verdict) {
+        d->misses.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        d->hits.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return verdict;
+}
+
+void VerdictCache::insert(const QString &word, bool correct)
+{
+    Q_D(VerdictCache);
+
+    quint32 currentGeneration = d->generation.load(std::memory_order_acquire);
+    VerdictCachePrivate::Shard &shard = d->shardFor(word);
+
+    QMutexLocker locker(&shard.mutex);
+
+    if (shard.entries.size() >= d->shardCapacity) {
+        d->evict(shard, currentGeneration);
+    }
+
+    shard.entries.insert(word, { currentGeneration, correct });
+}
+
+void VerdictCache::invalidate()
+{
+    Q_D(VerdictCache);
+
+    d->generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+quint32 VerdictCache::generation() const
+{
+    Q_D(const VerdictCache);
+
+    return d->generation.load(std::memory_order_acquire);
+}
+
+quint64 VerdictCache::hitCount() const
+{
+    Q_D(const VerdictCache);
+
+    return d->hits.load(std::memory_order_relaxed);
+}
+
+quint64 VerdictCache::missCount() const
+{
+    Q_D(const VerdictCache);
+
+    return d->misses.load(std::memory_order_relaxed);
+}
+
+double VerdictCache::hitRate() const
+{
+    quint64 hits = hitCount();
+    quint64 total = hits + missCount();
+
+    if (0 == total) {
+        return 0.0;
+    }
+
+    return double(hits) / double(total);
+}
+
+void VerdictCache::resetCounters()
+{
+    Q_D(VerdictCache);
+
+    d->hits.store(0, std::memory_order_relaxed);
+    d->misses.store(0, std::memory_order_relaxed);
+}
+
+VerdictCachePrivate::Shard &VerdictCachePrivate::shardFor(const QString &word) const
+{
+    return shards[qHash(word) & (ShardCount - 1)];
+}
+
+void VerdictCachePrivate::evict(Shard &shard, quint32 currentGeneration)
+{
+    auto iter = shard.entries.begin();
+
+    while (iter != shard.entries.end()) {
+        if (iter->generation != currentGeneration) {
+            iter = shard.entries.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    if (shard.entries.size() >= shardCapacity) {
+        shard.entries.clear();
+    }
+}
+} // namespace ghostwriter
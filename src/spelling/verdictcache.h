@@ -0,0 +1,112 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef VERDICT_CACHE_H
+#define VERDICT_CACHE_H
+
+#include <QScopedPointer>
+#include <QString>
+#include <QtGlobal>
+
+namespace ghostwriter
+{
+/**
+ * Bounded, sharded cache of word to spelling verdict (correct or
+ * misspelled) for a single dictionary.  Each shard is guarded by its own
+ * lock so that concurrent lookups from worker threads rarely contend.
+ *
+ * Entries are tagged with a generation number.  Calling invalidate()
+ * bumps the generation, which makes every existing entry stale without
+ * having to walk the shards.  Stale entries are dropped lazily as they
+ * are encountered or when a shard fills up.
+ */
+class VerdictCachePrivate;
+class VerdictCache
+{
+    Q_DECLARE_PRIVATE(VerdictCache)
+
+public:
+    /**
+     * Result of a cache lookup.
+     */
+    enum Verdict {
+        Unknown,
+        Correct,
+        Misspelled
+    };
+
+    /**
+     * Constructor.  Takes the maximum number of words to cache.
+     */
+    VerdictCache(int capacity = 32768);
+
+    /**
+     * Destructor.
+     */
+    ~VerdictCache();
+
+    /**
+     * Returns the cached verdict for the given word, or Unknown if the
+     * word is not in the cache or its entry is stale.
+     */
+    Verdict lookup(const QString &word) const;
+
+    /**
+     * Caches the verdict for the given word under the current generation.
+     */
+    void insert(const QString &word, bool correct);
+
+    /**
+     * Marks all cached verdicts as stale.  Call whenever the outcome of a
+     * spell check could change, such as when words are added to or
+     * removed from the dictionary session.
+     */
+    void invalidate();
+
+    /**
+     * Returns the current generation number.
+     */
+    quint32 generation() const;
+
+    /**
+     * Returns the number of lookups that were answered from the cache.
+     */
+    quint64 hitCount() const;
+
+    /**
+     * Returns the number of lookups that were not answered from the cache.
+     */
+    quint64 missCount() const;
+
+    /**
+     * Returns the ratio of hits to total lookups, between 0.0 and 1.0.
+     */
+    double hitRate() const;
+
+    /**
+     * Resets the hit and miss counters to zero.
+     */
+    void resetCounters();
+
+private:
+    QScopedPointer<VerdictCachePrivate> d_ptr;
+};
+} // namespace ghostwriter
+
+#endif // VERDICT_CACHE_H
@@ -0,0 +1,337 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <atomic>
+
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QTextBlock>
+#include <QtConcurrentRun>
+
+#include "trigramindex.h"
+
+// Changes spanning more blocks than this discard the index instead of
+// updating it in place.
+#define GW_TRIGRAM_INDEX_MAX_UPDATE_BLOCKS 512
+
+namespace ghostwriter
+{
+class TrigramIndexPrivate
+{
+    Q_DECLARE_PUBLIC(TrigramIndex)
+
+public:
+    /*
+    * Bit signature of the trigrams in a block.  At 256 bits, typical
+    * lines and paragraphs leave most bits clear, while the index stays
+    * small enough for documents with hundreds of thousands of blocks.
+    */
+    struct Signature
+    {
+        quint64 bits[4] = { 0, 0, 0, 0 };
+
+        bool contains(const Signature &other) const
+        {
+            return ((bits[0] & other.bits[0]) == other.bits[0])
+                && ((bits[1] & other.bits[1]) == other.bits[1])
+                && ((bits[2] & other.bits[2]) == other.bits[2])
+                && ((bits[3] & other.bits[3]) == other.bits[3]);
+        }
+    };
+
+    typedef QVector<Signature> SignatureList;
+
+    TrigramIndexPrivate(TrigramIndex *q_ptr)
+        : q_ptr(q_ptr),
+          document(nullptr),
+          buildWatcher(nullptr),
+          buildRevision(0),
+          ready(false)
+    {
+        ;
+    }
+
+    ~TrigramIndexPrivate()
+    {
+        ;
+    }
+
+    TrigramIndex *q_ptr;
+    QTextDocument *document;
+
+    // One signature per block, indexed by block number.
+    SignatureList signatures;
+
+    QFutureWatcher<SignatureList> *buildWatcher;
+    QSharedPointer<std::atomic<bool>> buildCanceled;
+    int buildRevision;
+    bool ready;
+
+    /*
+    * Returns the signature of the trigrams in the given text.
+    */
+    static Signature signatureOf(const QChar *text, int length);
+
+    /*
+    * Returns the signature of each of the given block texts.  Runs on a
+    * worker thread, and gives up early once canceled is set.
+    */
+    static SignatureList buildSignatures
+    (
+        const QStringList &blockTexts,
+        QSharedPointer<std::atomic<bool>> canceled
+    );
+
+    /*
+    * Updates the signatures of the blocks touched by a document change.
+    */
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+    void onBuildFinished();
+
+    /*
+    * Discards the index, to be built again by the next call to build().
+    */
+    void discard();
+};
+
+TrigramIndex::TrigramIndex(QTextDocument *document, QObject *parent)
+    : QObject(parent),
+      d_ptr(new TrigramIndexPrivate(this))
+{
+    Q_D(TrigramIndex);
+
+    d->document = document;
+    d->buildWatcher = new QFutureWatcher<TrigramIndexPrivate::SignatureList>(this);
+
+    this->connect(d->buildWatcher,
+        &QFutureWatcherBase::finished,
+        [d]() {
+            d->onBuildFinished();
+        });
+
+    this->connect(document,
+        &QTextDocument::contentsChange,
+        this,
+        [d](int position, int charsRemoved, int charsAdded) {
+            d->onContentsChange(position, charsRemoved, charsAdded);
+        });
+}
+
+TrigramIndex::~TrigramIndex()
+{
+    Q_D(TrigramIndex);
+
+    if (!d->buildCanceled.isNull()) {
+        d->buildCanceled->store(true);
+    }
+}
+
+void TrigramIndex::build()
+{
+    Q_D(TrigramIndex);
+
+    if (d->ready || !d->buildCanceled.isNull()) {
+        return;
+    }
+
+    // Take the text of each block rather than the document's plain
+    // text, in which line separators within a block would read as block
+    // breaks, leaving more lines than there are blocks.
+    QStringList blockTexts;
+    blockTexts.reserve(d->document->blockCount());
+
+    for (QTextBlock block = d->document->begin(); block.isValid(); block = block.next()) {
+        blockTexts.append(block.text());
+    }
+
+    d->buildRevision = d->document->revision();
+    d->buildCanceled.reset(new std::atomic<bool>(false));
+    d->buildWatcher->setFuture
+    (
+        QtConcurrent::run
+        (
+            &TrigramIndexPrivate::buildSignatures,
+            blockTexts,
+            d->buildCanceled
+        )
+    );
+}
+
+bool TrigramIndex::isReady() const
+{
+    Q_D(const TrigramIndex);
+
+    return d->ready;
+}
+
+bool TrigramIndex::candidateBlocks(const QString &text, QVector<int> &blockNumbers) const
+{
+    Q_D(const TrigramIndex);
+
+    if (!d->ready || (text.length() < 3)
+            || (d->signatures.size() != d->document->blockCount())) {
+        return false;
+    }
+
+    TrigramIndexPrivate::Signature query =
+        TrigramIndexPrivate::signatureOf(text.constData(), text.length());
+
+    blockNumbers.clear();
+
+    for (int i = 0; i < d->signatures.size(); i++) {
+        if (d->signatures[i].contains(query)) {
+            blockNumbers.append(i);
+        }
+    }
+
+    return true;
+}
+
+TrigramIndexPrivate::Signature TrigramIndexPrivate::signatureOf(const QChar *text, int length)
+{
+    Signature signature;
+
+    if (length < 3) {
+        return signature;
+    }
+
+    // Case folding is applied per character, just like case insensitive
+    // string matching, so that the signature of a block holds the bits of
+    // every query it could match, whatever the case.
+    quint32 a = text[0].toCaseFolded().unicode();
+    quint32 b = text[1].toCaseFolded().unicode();
+
+    for (int i = 2; i < length; i++) {
+        quint32 c = text[i].toCaseFolded().unicode();
+        quint32 hash = (((a * 31u) + b) * 31u + c) * 0x9E3779B1u;
+        int bit = hash >> 24;
+
+        signature.bits[bit >> 6] |= Q_UINT64_C(1) << (bit & 63);
+        a = b;
+        b = c;
+    }
+
+    return signature;
+}
+
+TrigramIndexPrivate::SignatureList TrigramIndexPrivate::buildSignatures
+(
+    const QStringList &blockTexts,
+    QSharedPointer<std::atomic<bool>> canceled
+)
+{
+    SignatureList signatures;
+    signatures.reserve(blockTexts.size());
+
+    for (const QString &text : blockTexts) {
+        if (canceled->load()) {
+            return SignatureList();
+        }
+
+        signatures.append(signatureOf(text.constData(), text.length()));
+    }
+
+    return signatures;
+}
+
+void TrigramIndexPrivate::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved)
+
+    // A build in progress notices the change by itself once done.
+    if (!this->ready) {
+        return;
+    }
+
+    QTextBlock first = this->document->findBlock(position);
+    QTextBlock last = this->document->findBlock(position + charsAdded);
+
+    if (!first.isValid()) {
+        discard();
+        return;
+    }
+
+    if (!last.isValid()) {
+        last = this->document->lastBlock();
+    }
+
+    // The blocks from first to last replace as many old blocks as it
+    // takes to account for the change in block count.
+    int firstNumber = first.blockNumber();
+    int newCount = last.blockNumber() - firstNumber + 1;
+    int oldCount = newCount - (this->document->blockCount() - this->signatures.size());
+
+    if ((oldCount < 1) || ((firstNumber + oldCount) > this->signatures.size())
+            || (newCount > GW_TRIGRAM_INDEX_MAX_UPDATE_BLOCKS)) {
+        discard();
+        return;
+    }
+
+    if (newCount > oldCount) {
+        this->signatures.insert(firstNumber, newCount - oldCount, Signature());
+    } else if (newCount < oldCount) {
+        this->signatures.remove(firstNumber, oldCount - newCount);
+    }
+
+    QTextBlock block = first;
+
+    for (int i = 0; i < newCount; i++) {
+        QString text = block.text();
+        this->signatures[firstNumber + i] = signatureOf(text.constData(), text.length());
+        block = block.next();
+    }
+}
+
+void TrigramIndexPrivate::onBuildFinished()
+{
+    Q_Q(TrigramIndex);
+
+    if (this->buildWatcher->isCanceled() || this->buildCanceled.isNull()
+            || this->buildCanceled->load()) {
+        return;
+    }
+
+    SignatureList result = this->buildWatcher->result();
+    this->buildCanceled.reset();
+
+    // The snapshot is stale if the document was edited in the meantime.
+    if ((this->document->revision() != this->buildRevision)
+            || (result.size() != this->document->blockCount())) {
+        q->build();
+        return;
+    }
+
+    this->signatures = result;
+    this->ready = true;
+    emit q->ready();
+}
+
+void TrigramIndexPrivate::discard()
+{
+    if (!this->buildCanceled.isNull()) {
+        this->buildCanceled->store(true);
+        this->buildCanceled.reset();
+    }
+
+    this->ready = false;
+    this->signatures.clear();
+}
+} // namespace ghostwriter
@@ -0,0 +1,94 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QString>
+#include <QTextDocument>
+#include <QVector>
+
+namespace ghostwriter
+{
+/**
+ * Index of the trigrams (runs of three characters, ignoring case) found
+ * in each block of a text document, used to narrow a literal search in a
+ * very large document down to the few blocks that may contain the query.
+ *
+ * Each block is summarized by a small bit signature of its trigrams.  A
+ * block can only contain the query if its signature includes every bit
+ * of the query's signature, so the blocks that fail that test can be
+ * skipped without looking at their text.  Blocks that pass must still be
+ * searched, since different trigrams can share a bit.
+ *
+ * The index is built on a worker thread, and then kept up to date on
+ * every change to the document.  Changes that span many blocks, such as
+ * loading a new file, discard the index until build() is called again.
+ */
+class TrigramIndexPrivate;
+class TrigramIndex : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(TrigramIndex)
+
+public:
+    /**
+     * Constructor.  The index is empty until build() is called.
+     */
+    TrigramIndex(QTextDocument *document, QObject *parent = nullptr);
+
+    /**
+     * Destructor.
+     */
+    ~TrigramIndex();
+
+    /**
+     * Starts building the index in the background, unless it is already
+     * built or being built.
+     */
+    void build();
+
+    /**
+     * Returns true if the index is built and up to date.
+     */
+    bool isReady() const;
+
+    /**
+     * Finds the numbers of the blocks that may contain the given text,
+     * in document order, regardless of case.  Returns false if the index
+     * cannot narrow the search, either because it is not ready or because
+     * the text is too short to contain a trigram, in which case every
+     * block has to be searched.
+     */
+    bool candidateBlocks(const QString &text, QVector<int> &blockNumbers) const;
+
+signals:
+    /**
+     * Emitted when the index has been built and can narrow searches.
+     */
+    void ready();
+
+private:
+    QScopedPointer<TrigramIndexPrivate> d_ptr;
+};
+} // namespace ghostwriter
+
+#endif // TRIGRAM_INDEX_H
@@ -25,6 +25,7 @@
 #include <QDir>
 #include <QTextStream>
 #include <QString>
+#include <QTimer>
 
 #include "../src/asynctextwriter.h"
 
@@ -64,6 +65,16 @@ private slots:
     void writeToReadOnlyFile();
     void writeToReadOnlyDirectory();
     void writeAlreadyInProgress();
+    void writeCoalescesPendingWrites();
+    void waitForFinishedWithoutEventLoop();
+    void setDurability();
+    void writeWithDurability_data();
+    void writeWithDurability();
+    void writeUtf8AcrossChunks();
+    void writeUnpairedSurrogate();
+    void replaceWithoutSyncKeepsPermissions();
+    void writeWithoutSyncNewFilePermissions();
+    void writeRotatesBackups();
 };
 
 void AsyncTextWriterTest::runWriteTest(const QString &fileName,
@@ -392,11 +403,9 @@ void AsyncTextWriterTest::writeAlreadyInProgress()
     firstCallStatus = writer.write("Hello, world!\n");
     secondCallStatus = writer.write(expectedContents);
 
-    // Give the thread time to complete the writes.
-    QThread::sleep(1);
-
-    // Force signal/event processing.
-    qApp->processEvents();
+    // The second write only starts once the first one's completion has
+    // been processed, so keep processing events until both are done.
+    QTRY_VERIFY_WITH_TIMEOUT(!writer.writeInProgress(), 5000);
 
     // Verify first call's return value.
     QCOMPARE(firstCallStatus, true);
@@ -430,5 +439,420 @@ void AsyncTextWriterTest::writeAlreadyInProgress()
     }
 }
 
+/**
+ * OBJECTIVE:
+ *      Wait for a write and the write pending behind it to finish.
+ *
+ * INPUTS:
+ *      Two calls to write() in a row, with a zero timer queued before
+ *      waiting for them.
+ *
+ * EXPECTED RESULTS:
+ *      - writeComplete() is received twice before waitForFinished()
+ *        returns, without the timer having fired.
+ *      - writeComplete() is not received again once the event loop runs.
+ */
+void AsyncTextWriterTest::waitForFinishedWithoutEventLoop()
+{
+    int writesCompleted = 0;
+    bool timerFired = false;
+
+    AsyncTextWriter writer("wait.txt");
+
+    this->connect(
+        &writer,
+        &AsyncTextWriter::writeComplete,
+        [&writesCompleted]() {
+            writesCompleted++;
+        }
+    );
+
+    QVERIFY(writer.write("first\n"));
+    QVERIFY(writer.write("second\n"));
+
+    QTimer::singleShot(0, [&timerFired]() {
+        timerFired = true;
+    });
+
+    writer.waitForFinished();
+
+    QCOMPARE(writer.writeInProgress(), false);
+    QCOMPARE(writesCompleted, 2);
+    QCOMPARE(timerFired, false);
+
+    QTest::qWait(50);
+
+    QCOMPARE(timerFired, true);
+    QCOMPARE(writesCompleted, 2);
+
+    // Cleanup.
+    QFile::remove(writer.fileName());
+}
+
+/**
+ * OBJECTIVE:
+ *      Request several writes while a write is already in progress.
+ *
+ * INPUTS:
+ *      Three calls to write() in a row, each with a different string.
+ *
+ * EXPECTED RESULTS:
+ *      - write() returns true right away every time.
+ *      - The queue depth is 2 after the calls: the running write and a
+ *        single pending one.
+ *      - Only the first and last strings are written, so writeComplete()
+ *        is received twice.
+ *      - queueChanged() reports an empty queue and a latency once done.
+ *      - File contents match the input string of the final write() call.
+ */
+void AsyncTextWriterTest::writeCoalescesPendingWrites()
+{
+    int writesCompleted = 0;
+    int lastQueueDepth = -1;
+    qint64 lastLatency = -1;
+    QString expectedContents = "third\n";
+
+    AsyncTextWriter writer("coalesce.txt");
+
+    this->connect(
+        &writer,
+        &AsyncTextWriter::writeComplete,
+        [&writesCompleted]() {
+            writesCompleted++;
+        }
+    );
+
+    this->connect(
+        &writer,
+        &AsyncTextWriter::queueChanged,
+        [&lastQueueDepth, &lastLatency](int queueDepth, qint64 latency) {
+            lastQueueDepth = queueDepth;
+            lastLatency = latency;
+        }
+    );
+
+    QCOMPARE(writer.queueDepth(), 0);
+    QCOMPARE(writer.lastLatency(), qint64(-1));
+
+    QVERIFY(writer.write("first\n"));
+    QVERIFY(writer.write("second\n"));
+    QVERIFY(writer.write(expectedContents));
+
+    QCOMPARE(writer.queueDepth(), 2);
+    QCOMPARE(lastQueueDepth, 2);
+
+    writer.waitForFinished();
+
+    QCOMPARE(writer.writeInProgress(), false);
+    QCOMPARE(writer.queueDepth(), 0);
+    QCOMPARE(writesCompleted, 2);
+    QCOMPARE(lastQueueDepth, 0);
+    QVERIFY(lastLatency >= 0);
+    QCOMPARE(writer.lastLatency(), lastLatency);
+
+    QFile file(writer.fileName());
+    QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+    QCOMPARE(QString::fromUtf8(file.readAll()), expectedContents);
+    file.close();
+
+    // Cleanup.
+    file.remove();
+}
+
+/**
+ * OBJECTIVE:
+ *      Set the durability of writes (nominal case).
+ *
+ * INPUTS:
+ *      New durability.
+ *
+ * EXPECTED RESULTS:
+ *      - The default durability is SyncData.
+ *      - The durability is the one that was set.
+ */
+void AsyncTextWriterTest::setDurability()
+{
+    AsyncTextWriter writer("durabilitytest.txt");
+    QCOMPARE(writer.durability(), AsyncTextWriter::SyncData);
+
+    writer.setDurability(AsyncTextWriter::NoSync);
+    QCOMPARE(writer.durability(), AsyncTextWriter::NoSync);
+}
+
+void AsyncTextWriterTest::writeWithDurability_data()
+{
+    QTest::addColumn<int>("durability");
+    QTest::addColumn<bool>("fileExists");
+
+    QTest::newRow("NoSync new file") << int(AsyncTextWriter::NoSync) << false;
+    QTest::newRow("NoSync existing file") << int(AsyncTextWriter::NoSync) << true;
+    QTest::newRow("SyncData new file") << int(AsyncTextWriter::SyncData) << false;
+    QTest::newRow("SyncData existing file") << int(AsyncTextWriter::SyncData) << true;
+    QTest::newRow("SyncAll new file") << int(AsyncTextWriter::SyncAll) << false;
+    QTest::newRow("SyncAll existing file") << int(AsyncTextWriter::SyncAll) << true;
+}
+
+/**
+ * OBJECTIVE:
+ *      Call write() with each durability policy (nominal case).
+ *
+ * INPUTS:
+ *      - Durability policy.
+ *      - New file name, or the name of a file that already exists.
+ *
+ * EXPECTED RESULTS:
+ *      - writeComplete() signal is received.
+ *      - File contents match input string, and nothing of the previous
+ *        contents is left.
+ *      - No temporary file is left behind in the folder.
+ */
+void AsyncTextWriterTest::writeWithDurability()
+{
+    QFETCH(int, durability);
+    QFETCH(bool, fileExists);
+
+    QString fileName = "durability.txt";
+    QString expectedContents = "Durable text\nwith two lines\n";
+    QStringList filesBefore = QDir().entryList(QDir::Files | QDir::Hidden);
+
+    if (fileExists) {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        file.write("Previous, much longer contents of the file that must go away.\n");
+        file.close();
+        filesBefore = QDir().entryList(QDir::Files | QDir::Hidden);
+    }
+
+    bool writeCompleted = false;
+    AsyncTextWriter writer(fileName);
+    writer.setDurability(AsyncTextWriter::Durability(durability));
+
+    this->connect(
+        &writer,
+        &AsyncTextWriter::writeComplete,
+        [&writeCompleted]() {
+            writeCompleted = true;
+        }
+    );
+
+    QVERIFY(writer.write(expectedContents));
+    writer.waitForFinished();
+    QVERIFY(writeCompleted);
+
+    QFile file(writer.fileName());
+    QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+    QCOMPARE(QString::fromUtf8(file.readAll()), expectedContents);
+    file.close();
+
+    QStringList filesAfter = QDir().entryList(QDir::Files | QDir::Hidden);
+
+    if (!fileExists) {
+        filesAfter.removeAll(fileName);
+    }
+
+    QCOMPARE(filesAfter, filesBefore);
+
+    // Cleanup.
+    file.remove();
+}
+
+/**
+ * OBJECTIVE:
+ *      Write UTF-8 text that is longer than the chunks it is encoded in.
+ *
+ * INPUTS:
+ *      Text of over a million code units mixing one, two, three and four
+ *      byte characters, with surrogate pairs placed around every likely
+ *      chunk boundary.
+ *
+ * EXPECTED RESULTS:
+ *      - File contents are byte for byte the same as QString::toUtf8().
+ */
+void AsyncTextWriterTest::writeUtf8AcrossChunks()
+{
+    QString emoji = QString::fromUtf8("\xF0\x9F\x98\x80");
+    QString mixed = QString::fromUtf8("ascii \xC3\xA9t\xC3\xA9 \xE6\x97\xA5\xE6\x9C\xAC ");
+    QString text;
+
+    while (text.length() < (1100 * 1024)) {
+        int boundary = ((text.length() / 1024) + 1) * 1024;
+
+        // Straddle every multiple of 1024 code units, and thus every
+        // chunk boundary, with an emoji.
+        text.append(QString(boundary - text.length() - 1, QChar('a')));
+        text.append(emoji);
+        text.append(mixed);
+    }
+
+    AsyncTextWriter writer("chunks.txt");
+    QVERIFY(writer.write(text));
+    writer.waitForFinished();
+
+    QFile file(writer.fileName());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray actual = file.readAll();
+    file.close();
+
+    QVERIFY(actual == text.toUtf8());
+
+    // Cleanup.
+    file.remove();
+}
+
+/**
+ * OBJECTIVE:
+ *      Write UTF-8 text holding surrogates that are not part of a pair
+ *      (robustness case).
+ *
+ * INPUTS:
+ *      Text with a lone high surrogate in the middle and a lone low
+ *      surrogate at the end.
+ *
+ * EXPECTED RESULTS:
+ *      - Each lone surrogate is written as U+FFFD.
+ */
+void AsyncTextWriterTest::writeUnpairedSurrogate()
+{
+    QString text = QString("abc") + QChar(0xD800) + QString("defghijklmnop") + QChar(0xDC00);
+
+    AsyncTextWriter writer("surrogate.txt");
+    QVERIFY(writer.write(text));
+    writer.waitForFinished();
+
+    QFile file(writer.fileName());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), QByteArray("abc\xEF\xBF\xBD" "defghijklmnop\xEF\xBF\xBD"));
+    file.close();
+
+    // Cleanup.
+    file.remove();
+}
+
+/**
+ * OBJECTIVE:
+ *      Replace an existing file without syncing to disk.
+ *
+ * INPUTS:
+ *      Existing file with non-default permissions.
+ *
+ * EXPECTED RESULTS:
+ *      - The file keeps its permissions after being replaced.
+ */
+void AsyncTextWriterTest::replaceWithoutSyncKeepsPermissions()
+{
+#ifdef Q_OS_UNIX
+    QString fileName = "permissions.txt";
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("old\n");
+    file.close();
+
+    QFileDevice::Permissions permissions =
+        QFileDevice::ReadOwner | QFileDevice::WriteOwner
+        | QFileDevice::ReadUser | QFileDevice::WriteUser;
+    QVERIFY(file.setPermissions(permissions));
+
+    AsyncTextWriter writer(fileName);
+    writer.setDurability(AsyncTextWriter::NoSync);
+    QVERIFY(writer.write("new\n"));
+    writer.waitForFinished();
+
+    QCOMPARE(QFile::permissions(fileName), permissions);
+
+    // Cleanup.
+    file.remove();
+#else
+    QSKIP("Only files on Unix are replaced without syncing.");
+#endif
+}
+
+/**
+ * OBJECTIVE:
+ *      Create a new file without syncing to disk.
+ *
+ * INPUTS:
+ *      Path of a file that does not exist yet.
+ *
+ * EXPECTED RESULTS:
+ *      - The file is created with the same permissions as any other new
+ *        file, as set by the umask.
+ */
+void AsyncTextWriterTest::writeWithoutSyncNewFilePermissions()
+{
+    QString fileName = "newpermissions.txt";
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.close();
+
+    QFileDevice::Permissions permissions = QFile::permissions(fileName);
+    QVERIFY(file.remove());
+
+    AsyncTextWriter writer(fileName);
+    writer.setDurability(AsyncTextWriter::NoSync);
+    QVERIFY(writer.write("new\n"));
+    writer.waitForFinished();
+
+    QCOMPARE(QFile::permissions(fileName), permissions);
+
+    // Cleanup.
+    file.remove();
+}
+
+/**
+ * OBJECTIVE:
+ *      Back up the file before each write, keeping only the most recent
+ *      backups (nominal case).
+ *
+ * INPUTS:
+ *      Backup count of two, and four writes to an existing file.
+ *
+ * EXPECTED RESULTS:
+ *      - No backups are made by default.
+ *      - Two backups are left, holding the contents of the file before
+ *        the last two writes, oldest first.
+ */
+void AsyncTextWriterTest::writeRotatesBackups()
+{
+    QDir dir("backuptest");
+    QVERIFY(dir.mkpath("."));
+
+    QString fileName = dir.filePath("backups.txt");
+    QStringList filters("backups.txt.*.backup");
+
+    AsyncTextWriter writer(fileName);
+    QCOMPARE(writer.backupCount(), 0);
+    QVERIFY(writer.write("first\n"));
+    writer.waitForFinished();
+    QVERIFY(dir.entryList(filters, QDir::Files).isEmpty());
+
+    writer.setBackupCount(2);
+    QCOMPARE(writer.backupCount(), 2);
+
+    const QStringList contents = { "second\n", "third\n", "fourth\n" };
+
+    for (const QString &text : contents) {
+        // Keep the millisecond timestamps of the backups apart.
+        QTest::qWait(5);
+        QVERIFY(writer.write(text));
+        writer.waitForFinished();
+    }
+
+    QStringList backups = dir.entryList(filters, QDir::Files, QDir::Name);
+    QCOMPARE(backups.size(), 2);
+
+    QFile backup(dir.filePath(backups[0]));
+    QVERIFY(backup.open(QIODevice::ReadOnly | QIODevice::Text));
+    QCOMPARE(QString::fromUtf8(backup.readAll()), QString("second\n"));
+    backup.close();
+
+    backup.setFileName(dir.filePath(backups[1]));
+    QVERIFY(backup.open(QIODevice::ReadOnly | QIODevice::Text));
+    QCOMPARE(QString::fromUtf8(backup.readAll()), QString("third\n"));
+    backup.close();
+
+    // Cleanup.
+    dir.removeRecursively();
+}
+
 QTEST_MAIN(AsyncTextWriterTest)
 #include "asynctextwritertest.moc"
\ No newline at end of file
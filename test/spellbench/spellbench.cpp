@@ -0,0 +1,581 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QPlainTextEdit>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QScrollBar>
+#include <QString>
+#include <QStringRef>
+#include <QTest>
+#include <QTextBlock>
+#include <QTextLayout>
+#include <QVector>
+
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+#include "../../src/cmarkgfmapi.h"
+#include "../../src/markdowndocument.h"
+
+#include "../../src/spelling/dictionary.h"
+#include "../../src/spelling/dictionarymanager.h"
+#include "../../src/spelling/spellcheckdecorator.h"
+#include "../../src/spelling/suggestioncache.h"
+
+using namespace ghostwriter;
+
+/**
+ * Benchmarks for spell checking.  Uses the small Hunspell dictionary in
+ * the dictionaries fixture directory so that results are comparable
+ * between machines.
+ *
+ * The corpora are English prose, Markdown mixed with code, CJK text and
+ * a generated word list with some misspellings mixed in.  Besides the
+ * usual QBENCHMARK results, throughput is reported in words per second,
+ * along with the 99th percentile latency of editing a single block in the
+ * decorated editor and the growth in resident memory, so that regressions
+ * show up as changes in these lines.
+ */
+class SpellBench : public QObject
+{
+    Q_OBJECT
+
+private:
+    Dictionary *dictionary;
+
+    /**
+     * Returns a single block of text resembling a long line of pasted
+     * code, in which nearly every word is misspelled.
+     */
+    QString pastedCodeBlock(int repetitions) const;
+
+    /**
+     * Returns the non-empty lines of the given file in the corpora
+     * fixture directory, repeated the given number of times.
+     */
+    QStringList corpus(const QString &name, int repetitions) const;
+
+    /**
+     * Returns the number of words in the given lines.
+     */
+    int wordCount(const QStringList &lines) const;
+
+    /**
+     * Returns the given number of lines of words from the fixture
+     * dictionary, with about one word in ten misspelled.  The words are
+     * always the same for the same seed.
+     */
+    QStringList generatedCorpus(int lineCount, quint32 seed) const;
+
+    /**
+     * Returns the lines of the corpus named in the current test data row.
+     */
+    QStringList corpusForTestData() const;
+
+    /**
+     * Returns the resident memory of the process in bytes, or -1 if it
+     * cannot be determined on this platform.
+     */
+    qint64 residentMemory() const;
+
+    /**
+     * Adds a test data row for each corpus.
+     */
+    void addCorpusRows() const;
+
+private slots:
+    void initTestCase();
+    void checkAllMatchesCheck();
+    void checkAllPastedCode();
+    void checkIterativelyPastedCode();
+    void checkAllCorpus_data();
+    void checkAllCorpus();
+    void suggestionsForMisspellings();
+    void decorateCorpus_data();
+    void decorateCorpus();
+    void decoratePastedCode();
+    void decorateSkipsCodeAndUrls();
+    void decorateFollowsRemovedFence();
+    void prefetchedSuggestions();
+};
+
+QString SpellBench::pastedCodeBlock(int repetitions) const
+{
+    QString line = "std::vector<int> fooBar = getValues(ptr->m_count, idx_2); "
+        "if (nullptr != qobject_cast<QWidget *>(obj)) { emit valueChanged(tmp); } ";
+
+    return line.repeated(repetitions);
+}
+
+QStringList SpellBench::corpus(const QString &name, int repetitions) const
+{
+    QStringList lines;
+    QFile file(QFINDTESTDATA("corpora/" + name));
+
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        const QStringList fileLines = QString::fromUtf8(file.readAll()).split('\n');
+
+        for (const QString &line : fileLines) {
+            if (!line.trimmed().isEmpty()) {
+                lines.append(line);
+            }
+        }
+    }
+
+    QStringList result;
+
+    for (int i = 0; i < repetitions; i++) {
+        result += lines;
+    }
+
+    return result;
+}
+
+int SpellBench::wordCount(const QStringList &lines) const
+{
+    static const QRegularExpression separators("[^\\w'-]+");
+    int count = 0;
+
+    for (const QString &line : lines) {
+        count += line.split(separators, Qt::SkipEmptyParts).size();
+    }
+
+    return count;
+}
+
+QStringList SpellBench::generatedCorpus(int lineCount, quint32 seed) const
+{
+    QStringList words;
+    QFile file(QFINDTESTDATA("dictionaries/bench.dic"));
+
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        // Skip the word count on the first line.
+        file.readLine();
+
+        while (!file.atEnd()) {
+            QString word = QString::fromUtf8(file.readLine()).trimmed().section('/', 0, 0);
+
+            if (!word.isEmpty()) {
+                words.append(word);
+            }
+        }
+    }
+
+    QStringList lines;
+
+    if (words.isEmpty()) {
+        return lines;
+    }
+
+    QRandomGenerator random(seed);
+
+    for (int i = 0; i < lineCount; i++) {
+        QStringList line;
+
+        for (int j = 0; j < 12; j++) {
+            QString word = words.at(random.bounded(words.size()));
+
+            // Swap two letters to misspell the word.
+            if ((word.length() > 3) && (0 == random.bounded(10))) {
+                int k = random.bounded(word.length() - 1);
+                QChar letter = word.at(k);
+                word[k] = word.at(k + 1);
+                word[k + 1] = letter;
+            }
+
+            line.append(word);
+        }
+
+        lines.append(line.join(' ') + '.');
+    }
+
+    return lines;
+}
+
+QStringList SpellBench::corpusForTestData() const
+{
+    QFETCH(QString, corpusName);
+    QFETCH(int, repetitions);
+
+    if ("generated" == corpusName) {
+        return generatedCorpus(1000 * repetitions, 1);
+    }
+
+    return corpus(corpusName, repetitions);
+}
+
+qint64 SpellBench::residentMemory() const
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/statm");
+
+    if (file.open(QIODevice::ReadOnly)) {
+        // The second field is the resident set size in pages.
+        QList<QByteArray> fields = file.readAll().split(' ');
+
+        if (fields.size() > 1) {
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+
+    return -1;
+}
+
+void SpellBench::addCorpusRows() const
+{
+    QTest::addColumn<QString>("corpusName");
+    QTest::addColumn<int>("repetitions");
+
+    QTest::newRow("prose") << QString("prose.txt") << 50;
+    QTest::newRow("code") << QString("code.md") << 50;
+    QTest::newRow("cjk") << QString("cjk.txt") << 100;
+    QTest::newRow("generated") << QString("generated") << 1;
+}
+
+void SpellBench::initTestCase()
+{
+    QDir::setSearchPaths("dict", QStringList(QFINDTESTDATA("dictionaries")));
+    DictionaryManager::instance()->setDefaultLanguage("bench");
+
+    // The dictionary is loaded in the background, with a fallback that
+    // accepts every word standing in until it is ready.
+    QTRY_VERIFY(!DictionaryManager::instance()->requestDictionary()
+        ->check("the quick brwn fox", 0).isNull());
+
+    dictionary = DictionaryManager::instance()->requestDictionary();
+    QVERIFY(dictionary->isValid());
+}
+
+void SpellBench::checkAllMatchesCheck()
+{
+    QString text = "Thiss is the first sentence, and here is a secnd one. "
+        "Some wrds are misspeled in this paragraph.";
+
+    QVector<QStringRef> expected;
+    QStringRef word = dictionary->check(text, 0);
+
+    while (!word.isNull()) {
+        expected.append(word);
+        word = dictionary->check(text, word.position() + word.length());
+    }
+
+    QVector<QStringRef> actual = dictionary->checkAll(text);
+
+    QCOMPARE(actual.size(), expected.size());
+
+    for (int i = 0; i < actual.size(); i++) {
+        QCOMPARE(actual[i].position(), expected[i].position());
+        QCOMPARE(actual[i].length(), expected[i].length());
+    }
+}
+
+void SpellBench::checkAllPastedCode()
+{
+    QString text = pastedCodeBlock(200);
+
+    QBENCHMARK {
+        dictionary->checkAll(text);
+    }
+}
+
+void SpellBench::checkIterativelyPastedCode()
+{
+    QString text = pastedCodeBlock(200);
+
+    QBENCHMARK {
+        QStringRef word = dictionary->check(text, 0);
+
+        while (!word.isNull()) {
+            word = dictionary->check(text, word.position() + word.length());
+        }
+    }
+}
+
+void SpellBench::checkAllCorpus_data()
+{
+    addCorpusRows();
+}
+
+void SpellBench::checkAllCorpus()
+{
+    QStringList lines = corpusForTestData();
+    QVERIFY(!lines.isEmpty());
+
+    int words = wordCount(lines);
+    qint64 elapsed = 0;
+    int runs = 0;
+
+    QBENCHMARK {
+        QElapsedTimer timer;
+        timer.start();
+
+        for (const QString &line : lines) {
+            dictionary->checkAll(line);
+        }
+
+        elapsed += timer.nsecsElapsed();
+        runs++;
+    }
+
+    qInfo("%.0f words/second", (double(words) * runs * 1e9) / qMax(elapsed, qint64(1)));
+}
+
+void SpellBench::suggestionsForMisspellings()
+{
+    QStringList misspellings;
+    const QStringList lines = generatedCorpus(100, 2);
+
+    for (const QString &line : lines) {
+        for (const QStringRef &word : dictionary->checkAll(line)) {
+            if (!misspellings.contains(word.toString())) {
+                misspellings.append(word.toString());
+            }
+        }
+
+        if (misspellings.size() >= 20) {
+            break;
+        }
+    }
+
+    QVERIFY(!misspellings.isEmpty());
+
+    QBENCHMARK {
+        for (const QString &word : misspellings) {
+            dictionary->suggestions(word);
+        }
+    }
+}
+
+void SpellBench::decorateCorpus_data()
+{
+    addCorpusRows();
+}
+
+void SpellBench::decorateCorpus()
+{
+    QStringList lines = corpusForTestData();
+    QVERIFY(!lines.isEmpty());
+
+    QString text = lines.join('\n');
+    int words = wordCount(lines);
+    qint64 memoryBefore = residentMemory();
+
+    MarkdownDocument document(text);
+    document.setMarkdownAST(CmarkGfmAPI::instance()->parse(text, false));
+
+    QPlainTextEdit editor;
+    editor.resize(800, 600);
+    editor.setDocument(&document);
+
+    SpellCheckDecorator decorator(&editor);
+    editor.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&editor));
+
+    // Every block is pending, and scrolling checks the ones that come
+    // into view right away, so scrolling from top to bottom checks the
+    // whole document through the same path as the user would.
+    decorator.setErrorColor(Qt::red);
+
+    QScrollBar *scrollBar = editor.verticalScrollBar();
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int value = 0; value <= scrollBar->maximum(); value += qMax(1, scrollBar->pageStep())) {
+        scrollBar->setValue(value);
+    }
+
+    qint64 elapsed = timer.nsecsElapsed();
+    qint64 memoryAfter = residentMemory();
+
+    // Time single keystrokes in blocks spread over the document, each of
+    // which re-checks the edited block.
+    QVector<qint64> latencies;
+    int step = qMax(1, document.blockCount() / 200);
+
+    for (int i = 0; i < document.blockCount(); i += step) {
+        QTextCursor cursor(document.findBlockByNumber(i));
+        cursor.movePosition(QTextCursor::EndOfBlock);
+        editor.setTextCursor(cursor);
+        editor.ensureCursorVisible();
+
+        timer.restart();
+        cursor.insertText("x");
+        latencies.append(timer.nsecsElapsed());
+    }
+
+    QVERIFY(!latencies.isEmpty());
+    std::sort(latencies.begin(), latencies.end());
+    qint64 p99 = latencies.at(qMin(latencies.size() - 1, (latencies.size() * 99) / 100));
+
+    qInfo("%.0f words/second", (double(words) * 1e9) / qMax(elapsed, qint64(1)));
+    qInfo("p99 block latency: %.3f ms", double(p99) / 1e6);
+
+    if ((memoryBefore >= 0) && (memoryAfter >= 0)) {
+        qInfo("memory: %+.1f MiB", double(memoryAfter - memoryBefore) / (1024.0 * 1024.0));
+    } else {
+        qInfo("memory: n/a");
+    }
+}
+
+void SpellBench::decoratePastedCode()
+{
+    QPlainTextEdit editor;
+    editor.resize(800, 600);
+    editor.setPlainText(pastedCodeBlock(200));
+
+    SpellCheckDecorator decorator(&editor);
+    editor.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&editor));
+
+    // Setting the error color re-checks the blocks in view, which here
+    // is the single pathological block.
+    QBENCHMARK {
+        decorator.setErrorColor(Qt::red);
+    }
+}
+
+void SpellBench::decorateSkipsCodeAndUrls()
+{
+    QString text = "Thiss has `fooBar` and <span>words</span> at http://exmple.com/wrds\n"
+        "\n"
+        "```\n"
+        "qobject_cast<QWidget *>(obj)\n"
+        "```\n";
+
+    MarkdownDocument document(text);
+    document.setMarkdownAST(CmarkGfmAPI::instance()->parse(text, false));
+
+    QPlainTextEdit editor;
+    editor.resize(800, 600);
+    editor.setDocument(&document);
+
+    SpellCheckDecorator decorator(&editor);
+    editor.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&editor));
+    decorator.setErrorColor(Qt::red);
+
+    QVector<int> underlinesPerBlock;
+
+    for (QTextBlock block = document.begin(); block.isValid(); block = block.next()) {
+        int underlines = 0;
+
+        for (const QTextLayout::FormatRange &range : block.layout()->formats()) {
+            if (QTextCharFormat::SpellCheckUnderline == range.format.underlineStyle()) {
+                QCOMPARE(range.start, 0);
+                underlines++;
+            }
+        }
+
+        underlinesPerBlock.append(underlines);
+    }
+
+    // Only "Thiss" is prose, in the first block.
+    QCOMPARE(underlinesPerBlock.value(0), 1);
+
+    for (int i = 1; i < underlinesPerBlock.size(); i++) {
+        QCOMPARE(underlinesPerBlock[i], 0);
+    }
+}
+
+void SpellBench::decorateFollowsRemovedFence()
+{
+    QString text = "Intro\n"
+        "\n"
+        "```\n"
+        "wrds here\n"
+        "```\n";
+
+    MarkdownDocument document(text);
+    document.setMarkdownAST(CmarkGfmAPI::instance()->parse(text, false));
+
+    // Parse each change before the decorator sees it, as the editor does.
+    this->connect(&document,
+        static_cast<void (QTextDocument::*)(int, int, int)>(&QTextDocument::contentsChange),
+        [&document]() {
+            document.setMarkdownAST(
+                CmarkGfmAPI::instance()->parse(document.toPlainText(), false));
+        }
+    );
+
+    QPlainTextEdit editor;
+    editor.resize(800, 600);
+    editor.setDocument(&document);
+
+    SpellCheckDecorator decorator(&editor);
+    editor.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&editor));
+    decorator.setErrorColor(Qt::red);
+
+    auto underlines = [&document](int blockNumber) {
+        int count = 0;
+        QTextBlock block = document.findBlockByNumber(blockNumber);
+
+        for (const QTextLayout::FormatRange &range : block.layout()->formats()) {
+            if (QTextCharFormat::SpellCheckUnderline == range.format.underlineStyle()) {
+                count++;
+            }
+        }
+
+        return count;
+    };
+
+    QCOMPARE(underlines(3), 0);
+
+    // Removing the opening fence turns the code below it into prose,
+    // although the edited block itself stays blank.
+    QTextCursor cursor(document.findBlockByNumber(1));
+    cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor);
+    cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+
+    QCOMPARE(document.findBlockByNumber(1).text(), QString());
+    QCOMPARE(document.findBlockByNumber(2).text(), QString("wrds here"));
+    QCOMPARE(underlines(2), 1);
+}
+
+void SpellBench::prefetchedSuggestions()
+{
+    QStringList words;
+    words << "brwn" << "wrds" << "secnd";
+
+    SuggestionCache cache;
+    cache.prefetch(dictionary, words);
+
+    // Waits for any word still being prefetched.
+    for (const QString &word : words) {
+        QCOMPARE(cache.suggestions(dictionary, word), dictionary->suggestions(word));
+        QVERIFY(cache.contains(dictionary, word));
+    }
+
+    QBENCHMARK {
+        cache.suggestions(dictionary, "wrds");
+    }
+}
+
+QTEST_MAIN(SpellBench)
+#include "spellbench.moc"
@@ -0,0 +1,77 @@
+################################################################################
+#
+# Copyright (C) 2022 wereturtle
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+################################################################################
+
+# Spell check benchmarks and regression tests.  Run with the offscreen
+# platform plugin when no display is available:
+#
+#     QT_QPA_PLATFORM=offscreen ./spellbench
+#
+# A single benchmark can be run for a single corpus, for example:
+#
+#     QT_QPA_PLATFORM=offscreen ./spellbench decorateCorpus:prose
+
+QT += testlib concurrent widgets
+TEMPLATE = app
+TARGET = spellbench
+CONFIG += c++17
+CONFIG += warn_on
+
+equals(QT_MAJOR_VERSION,6): QT += core5compat
+
+win32 {
+    include(../../3rdparty/hunspell/hunspell.pri)
+    INCLUDEPATH += ../../3rdparty/hunspell
+} else {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += hunspell
+}
+
+include(../../3rdparty/cmark-gfm/cmark-gfm.pri)
+
+INCLUDEPATH += ../.. ../../src ../../src/spelling
+
+# Input
+
+HEADERS += \
+    ../../src/cmarkgfmapi.h \
+    ../../src/markdownast.h \
+    ../../src/markdowndocument.h \
+    ../../src/markdownnode.h \
+    ../../src/memoryarena.h \
+    ../../src/spelling/dictionary.h \
+    ../../src/spelling/dictionaryprovider.h \
+    ../../src/spelling/dictionarymanager.h \
+    ../../src/spelling/hunspellprovider.h \
+    ../../src/spelling/spellchecker.h \
+    ../../src/spelling/spellcheckdecorator.h \
+    ../../src/spelling/suggestioncache.h \
+    ../../src/spelling/verdictcache.h
+
+SOURCES += spellbench.cpp \
+    ../../src/cmarkgfmapi.cpp \
+    ../../src/markdownast.cpp \
+    ../../src/markdowndocument.cpp \
+    ../../src/markdownnode.cpp \
+    ../../src/memoryarena.cpp \
+    ../../src/spelling/dictionarymanager.cpp \
+    ../../src/spelling/hunspellprovider.cpp \
+    ../../src/spelling/spellchecker.cpp \
+    ../../src/spelling/spellcheckdecorator.cpp \
+    ../../src/spelling/suggestioncache.cpp \
+    ../../src/spelling/verdictcache.cpp
@@ -0,0 +1,212 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2022 wereturtle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSaveFile>
+#include <QString>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QTextStream>
+
+#include "../../src/asynctextwriter.h"
+
+using namespace ghostwriter;
+
+// Size of the generated documents, in bytes of UTF-8.
+#define WRITEBENCH_DOCUMENT_SIZE (100 * 1024 * 1024)
+
+/**
+ * Benchmarks for writing large documents with AsyncTextWriter, for each
+ * encoding path and durability policy, alongside the QTextStream based
+ * writing it replaced.  Besides the usual QBENCHMARK results, throughput
+ * is reported in megabytes per second.
+ */
+class WriteBench : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir directory;
+    QString asciiDocument;
+    QString mixedDocument;
+
+    /**
+     * Returns a document of about WRITEBENCH_DOCUMENT_SIZE bytes made of
+     * the given line repeated.
+     */
+    static QString document(const QString &line);
+
+    const QString &documentForTestData() const;
+
+    static void reportThroughput(qint64 bytes, qint64 elapsed, int runs);
+
+private slots:
+    void initTestCase();
+    void writeDocument_data();
+    void writeDocument();
+    void streamBaseline_data();
+    void streamBaseline();
+};
+
+QString WriteBench::document(const QString &line)
+{
+    int lineSize = line.toUtf8().size();
+    QString text;
+    text.reserve((WRITEBENCH_DOCUMENT_SIZE / lineSize + 1) * line.length());
+
+    for (int size = 0; size < WRITEBENCH_DOCUMENT_SIZE; size += lineSize) {
+        text.append(line);
+    }
+
+    return text;
+}
+
+const QString &WriteBench::documentForTestData() const
+{
+    QFETCH(QString, text);
+
+    if ("mixed" == text) {
+        return mixedDocument;
+    }
+
+    return asciiDocument;
+}
+
+void WriteBench::reportThroughput(qint64 bytes, qint64 elapsed, int runs)
+{
+    qInfo("%.1f MB/second",
+        (double(bytes) * runs * 1e9) / (qMax(elapsed, qint64(1)) * 1024.0 * 1024.0));
+}
+
+void WriteBench::initTestCase()
+{
+    QVERIFY(directory.isValid());
+
+    asciiDocument = document("Lorem ipsum dolor sit amet, *consectetur* adipiscing elit, "
+        "sed do eiusmod tempor incididunt ut labore et dolore magna aliqua.\n");
+    mixedDocument = document(QString::fromUtf8("Caf\xC3\xA9 cr\xC3\xA8me br\xC3\xBBl\xC3\xA9" "e, "
+        "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE3\x81\xAE\xE6\x96\x87\xE7\xAB\xA0, "
+        "\xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 \xF0\x9F\x98\x80 and some ASCII.\n"));
+}
+
+void WriteBench::writeDocument_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("encoding");
+    QTest::addColumn<int>("durability");
+
+    QTest::newRow("ascii NoSync") << QString("ascii") << QString("UTF-8") << int(AsyncTextWriter::NoSync);
+    QTest::newRow("ascii SyncData") << QString("ascii") << QString("UTF-8") << int(AsyncTextWriter::SyncData);
+    QTest::newRow("ascii SyncAll") << QString("ascii") << QString("UTF-8") << int(AsyncTextWriter::SyncAll);
+    QTest::newRow("mixed SyncData") << QString("mixed") << QString("UTF-8") << int(AsyncTextWriter::SyncData);
+    QTest::newRow("ascii UTF-16") << QString("ascii") << QString("UTF-16") << int(AsyncTextWriter::SyncData);
+}
+
+void WriteBench::writeDocument()
+{
+    QFETCH(QString, encoding);
+    QFETCH(int, durability);
+
+    const QString &text = documentForTestData();
+    AsyncTextWriter writer(directory.filePath("document.md"));
+    bool failed = false;
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    writer.setEncoding(QTextCodec::codecForName(encoding.toLatin1()));
+#else
+    writer.setEncoding(("UTF-16" == encoding) ? QStringConverter::Utf16 : QStringConverter::Utf8);
+#endif
+
+    writer.setDurability(AsyncTextWriter::Durability(durability));
+
+    this->connect(&writer,
+        &AsyncTextWriter::writeError,
+        [&failed](const QString &err) {
+            qWarning("%s", qPrintable(err));
+            failed = true;
+        });
+
+    qint64 elapsed = 0;
+    int runs = 0;
+
+    QBENCHMARK {
+        QElapsedTimer timer;
+        timer.start();
+
+        writer.write(text);
+        writer.waitForFinished();
+
+        elapsed += timer.nsecsElapsed();
+        runs++;
+    }
+
+    QVERIFY(!failed);
+    reportThroughput(QFile(writer.fileName()).size(), elapsed, runs);
+}
+
+void WriteBench::streamBaseline_data()
+{
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("ascii") << QString("ascii");
+    QTest::newRow("mixed") << QString("mixed");
+}
+
+/*
+ * Writes the document the way AsyncTextWriter did before it had its own
+ * UTF-8 encoder, for comparison with writeDocument.
+ */
+void WriteBench::streamBaseline()
+{
+    const QString &text = documentForTestData();
+    QString fileName = directory.filePath("baseline.md");
+    qint64 elapsed = 0;
+    int runs = 0;
+
+    QBENCHMARK {
+        QElapsedTimer timer;
+        timer.start();
+
+        QSaveFile file(fileName);
+        file.setDirectWriteFallback(true);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text));
+
+        QTextStream stream(&file);
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        stream.setCodec("UTF-8");
+#else
+        stream.setEncoding(QStringConverter::Utf8);
+#endif
+
+        stream << text;
+        stream.flush();
+        QVERIFY(file.commit());
+
+        elapsed += timer.nsecsElapsed();
+        runs++;
+    }
+
+    reportThroughput(QFile(fileName).size(), elapsed, runs);
+}
+
+QTEST_MAIN(WriteBench)
+#include "writebench.moc"
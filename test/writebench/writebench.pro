@@ -0,0 +1,43 @@
+################################################################################
+#
+# Copyright (C) 2022 wereturtle
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+################################################################################
+
+# Throughput benchmarks for writing documents to disk.  Writes 100 MB
+# documents to a temporary folder, so make sure there is room for them:
+#
+#     ./writebench
+#
+# A single benchmark can be run for a single row, for example:
+#
+#     ./writebench writeDocument:"ascii SyncData"
+
+QT += testlib concurrent widgets
+TEMPLATE = app
+TARGET = writebench
+CONFIG += c++17
+CONFIG += warn_on
+
+INCLUDEPATH += ../.. ../../src
+
+# Input
+
+HEADERS += \
+    ../../src/asynctextwriter.h
+
+SOURCES += writebench.cpp \
+    ../../src/asynctextwriter.cpp